@@ -0,0 +1,228 @@
+// Benchmark for the gsqsolve search engines
+//
+// This runs a fixed set of boards through board::solve() and
+// board::count_solutions() with each engine, and writes out how long
+// they took and how many nodes the search visited as JSON:
+//
+//   $ ./gsqsolve-bench > before.json
+//
+// The boards are picked at random, but from a fixed seed so every run
+// sees the same ones.  There are two sets: one of genuine dice rolls
+// (which are all solvable) and one of any seven squares at all (many of
+// which aren't, so this also measures how fast a dead end is found).
+// The options are:
+//
+//   --boards N    how many boards are in each set (default 100)
+//   --seed N      which boards get picked (default 1)
+//   --engine X    only benchmark one engine (default is all of them)
+//
+// Each board is timed separately, giving the mean time per board along
+// with the median, 99th percentile and worst case.  (That means solving
+// them one at a time, so "simd" is just the loop nest here.)  The node
+// counts come from a second pass with search_stats switched on, so that
+// keeping them doesn't slow down the timed pass.  Each pass gives the memo
+// engine an empty table, so neither gets the benefit of what an earlier
+// one worked out.
+
+#define GSQSOLVE_NO_MAIN
+#include "gsqsolve.cpp"
+
+#include <chrono>
+
+namespace {
+
+enum class bench_op {
+	solve,
+	count,
+};
+
+struct bench_result {
+	std::uint64_t total_ns = 0;
+	std::uint64_t p50_ns = 0;
+	std::uint64_t p99_ns = 0;
+	std::uint64_t max_ns = 0;
+	// How many boards were solvable for bench_op::solve, or the total
+	// number of solutions for bench_op::count
+	std::uint64_t solutions = 0;
+	search_stats stats;
+};
+
+// Pick seven different squares, without regard to the dice
+[[nodiscard]] static auto random_squares() noexcept -> board_bitmask_t
+{
+	board_bitmask_t used = 0;
+
+	for (unsigned i = 0; i < 7;) {
+		auto const bit = static_cast<board_bitmask_t>(1) << (static_cast<unsigned>(std::rand()) % 36);
+		if ((used & bit) == 0) {
+			used += bit;
+			i++;
+		}
+	}
+	return used;
+}
+
+[[nodiscard]] static auto make_board_set(unsigned seed, unsigned num_boards, bool from_dice) -> std::vector<board_bitmask_t>
+{
+	std::srand(seed);
+	std::vector<board_bitmask_t> boards;
+	boards.reserve(num_boards);
+	for (unsigned i = 0; i < num_boards; i++)
+		boards.push_back(from_dice ? random_blockers() : random_squares());
+	return boards;
+}
+
+template<typename STATS>
+[[nodiscard]] static auto run_op(board_bitmask_t blockers, solver_engine engine, bench_op op, memo_table& memo, STATS& stats) noexcept -> unsigned
+{
+	board b(blockers, engine, &memo);
+	if (op == bench_op::solve)
+		return b.solve(stats) ? 1 : 0;
+	return b.count_solutions(stats);
+}
+
+// The value that 'percent' percent of the (sorted) samples are no larger than
+[[nodiscard]] static auto percentile(std::vector<std::uint64_t> const& sorted, unsigned percent) noexcept -> std::uint64_t
+{
+	assert(not sorted.empty());
+	auto const rank = (sorted.size() * percent + 99) / 100;
+	return sorted[rank == 0 ? 0 : rank - 1];
+}
+
+[[nodiscard]] static auto run_bench(std::vector<board_bitmask_t> const& boards, solver_engine engine, bench_op op) -> bench_result
+{
+	bench_result rv;
+	std::vector<std::uint64_t> times;
+	times.reserve(boards.size());
+
+	// The same size of table that count_solutions() would use on its
+	// own, but a new one for each pass
+	std::optional<memo_table> memo;
+	memo.emplace(lone_memo_log2_entries);
+	for (auto const blockers : boards) {
+		no_search_stats no_stats;
+		auto const start = std::chrono::steady_clock::now();
+		auto const solutions = run_op(blockers, engine, op, *memo, no_stats);
+		auto const end = std::chrono::steady_clock::now();
+		auto const ns = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+		times.push_back(ns);
+		rv.total_ns += ns;
+		rv.solutions += solutions;
+	}
+	memo.emplace(lone_memo_log2_entries);
+	for (auto const blockers : boards) {
+		auto const solutions = run_op(blockers, engine, op, *memo, rv.stats);
+		assert(solutions <= rv.solutions);
+		static_cast<void>(solutions);
+	}
+
+	std::sort(times.begin(), times.end());
+	rv.p50_ns = percentile(times, 50);
+	rv.p99_ns = percentile(times, 99);
+	rv.max_ns = times.back();
+	return rv;
+}
+
+static auto print_result(char const *engine, char const *board_set, char const *op, unsigned num_boards, bench_result const& r, bool last) noexcept -> void
+{
+	printf("    {\n");
+	printf("      \"engine\": \"%s\",\n", engine);
+	printf("      \"boards\": \"%s\",\n", board_set);
+	printf("      \"op\": \"%s\",\n", op);
+	printf("      \"ns_per_board\": %llu,\n", static_cast<unsigned long long>(r.total_ns / num_boards));
+	printf("      \"p50_ns\": %llu,\n", static_cast<unsigned long long>(r.p50_ns));
+	printf("      \"p99_ns\": %llu,\n", static_cast<unsigned long long>(r.p99_ns));
+	printf("      \"max_ns\": %llu,\n", static_cast<unsigned long long>(r.max_ns));
+	printf("      \"solutions\": %llu,\n", static_cast<unsigned long long>(r.solutions));
+	printf("      \"nodes\": {");
+	// Report the levels in the order the loop nest places them, with
+	// the single-square piece (which only the other engines place) last
+	for (auto const piece : placed_pieces)
+		printf(" \"%s\": %llu,", piece_names[static_cast<unsigned>(piece)],
+		       static_cast<unsigned long long>(r.stats.nodes[static_cast<unsigned>(piece)]));
+	printf(" \"%s\": %llu }\n", piece_names[static_cast<unsigned>(piece_id::single_block)],
+	       static_cast<unsigned long long>(r.stats.nodes[static_cast<unsigned>(piece_id::single_block)]));
+	printf("    }%s\n", last ? "" : ",");
+}
+
+static auto bench_usage(FILE *f) noexcept -> void
+{
+	fputs("Usage: gsqsolve-bench [--boards N] [--seed N] [--engine loop-nest|cell-driven|dlx|memo|simd|narrowing]\n", f);
+}
+
+} // anonymous namespace
+
+auto main(int argn, char const * const *argv) noexcept -> int
+{
+	unsigned num_boards = 100;
+	unsigned seed = 1;
+	std::vector<engine_name> engines(engine_names.begin(), engine_names.end());
+
+	for (int i = 1; i < argn; i++) {
+		auto const arg = argv[i];
+		if (0 == strcmp(arg, "--help")) {
+			bench_usage(stdout);
+			return EX_OK;
+		}
+		if (i + 1 == argn) {
+			[[unlikely]] bench_usage(stderr);
+			return EX_USAGE;
+		}
+		auto const value = argv[++i];
+		if (0 == strcmp(arg, "--boards")) {
+			if (not parse_unsigned(value, num_boards) or num_boards == 0) {
+				[[unlikely]] fprintf(stderr, "Error: Bad board count: \"%s\"\n", value);
+				return EX_USAGE;
+			}
+		} else if (0 == strcmp(arg, "--seed")) {
+			if (not parse_unsigned(value, seed)) {
+				[[unlikely]] fprintf(stderr, "Error: Bad seed: \"%s\"\n", value);
+				return EX_USAGE;
+			}
+		} else if (0 == strcmp(arg, "--engine")) {
+			solver_engine engine;
+			if (not parse_engine(value, engine)) {
+				[[unlikely]] fprintf(stderr, "Error: Unknown engine: \"%s\"\n", value);
+				return EX_USAGE;
+			}
+			std::erase_if(engines, [engine](engine_name const& e) { return e.engine != engine; });
+		} else {
+			[[unlikely]] bench_usage(stderr);
+			return EX_USAGE;
+		}
+	}
+
+	static constexpr struct {
+		char const *name;
+		bool from_dice;
+	} board_sets[] = {
+		{ "dice", true },
+		{ "any", false },
+	};
+	static constexpr struct {
+		char const *name;
+		bench_op op;
+	} ops[] = {
+		{ "solve", bench_op::solve },
+		{ "count", bench_op::count },
+	};
+
+	printf("{\n");
+	printf("  \"seed\": %u,\n", seed);
+	printf("  \"boards\": %u,\n", num_boards);
+	printf("  \"results\": [\n");
+	for (unsigned e = 0; e < engines.size(); e++) {
+		for (unsigned s = 0; s < std::size(board_sets); s++) {
+			auto const boards = make_board_set(seed, num_boards, board_sets[s].from_dice);
+			for (unsigned o = 0; o < std::size(ops); o++) {
+				auto const r = run_bench(boards, engines[e].engine, ops[o].op);
+				bool const last = e + 1 == engines.size() and s + 1 == std::size(board_sets) and o + 1 == std::size(ops);
+				print_result(engines[e].name, board_sets[s].name, ops[o].name, num_boards, r, last);
+				fflush(stdout);
+			}
+		}
+	}
+	printf("  ]\n");
+	printf("}\n");
+	return EX_OK;
+}
@@ -0,0 +1,44 @@
+/* The gsqsolve solver as a shared library, callable from C
+ *
+ * "make libgsqsolve.so" builds this.  It's the same solver as gsqsolve.h
+ * describes, and boards and solutions are encoded the same way: the
+ * blockers are a bitmask with bit (row * 6 + column) set for each one, and
+ * a solution is where each of the eight placed pieces (line4, square2_2,
+ * lblock3, zblock, tblock, line3, lblock2 and line2, in that order) went,
+ * as an index into that piece's array of placements.
+ *
+ * These can be called from any number of threads at once.  The only state
+ * they keep between calls is some scratch space for each thread that
+ * solves boards.
+ */
+
+#ifndef GSQSOLVE_C_H
+#define GSQSOLVE_C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define GSQSOLVE_C_API __attribute__((visibility("default")))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Solve one board, writing its solution to 'out_placements'.  Returns 1 if
+ * it was solved, or 0 (with all of 'out_placements' set to 0xFF) if it
+ * can't be. */
+GSQSOLVE_C_API int gsq_solve(uint64_t blockers, uint8_t out_placements[8]);
+
+/* How many different solutions 'blockers' has */
+GSQSOLVE_C_API unsigned gsq_count(uint64_t blockers);
+
+/* Solve 'num_boards' boards at once, writing the solution of boards[i] to
+ * out_placements[8 * i] through out_placements[8 * i + 7].  Returns how
+ * many of them were solved. */
+GSQSOLVE_C_API size_t gsq_solve_many(uint64_t const *boards, size_t num_boards, uint8_t *out_placements);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GSQSOLVE_C_H */
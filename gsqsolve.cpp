@@ -6,25 +6,150 @@
 //   $ ./gsqsolve c4 b1 e5 a6 d2 c5 a5
 //
 // ...and it will print a little ANSI color image of a solved board
-// position.
+// position.  The answer for every possible dice roll is worked out at
+// build time, so this doesn't even need to search (use "--no-table" if
+// you want it to anyway).
 //
 // The seven dice that come with the game have faces chosen so that
 // every board position they generate is solvable.  If you specify seven
 // "blocker" positions that can't come from the dice it will still
 // try to find a solution, but it will print a warning.
 //
+// Most boards have many solutions, and "--solutions N" prints the first N
+// of them instead of just one ("--solutions 0" prints all of them).  Each
+// one is printed as soon as the loop nest finds it, so this can't be
+// combined with a different search engine, "--stats" or "--db".
+//
 // The fact that the dice always generate a solution can be verified
 // by running:
 //
 //   $ ./gsqsolve --verify-all
 //
-// If no errors are detected it will simply exit quietly.
+// If no errors are detected it will simply exit quietly.  On a machine
+// with lots of cores this can be spread over several threads:
+//
+//   $ ./gsqsolve --verify-all --threads 8
+//
+// ...where "--threads 0" means to use one thread per CPU.
 //
 // It's also possible to iterate all possible dice values and count how
 // many solutions each of them has:
 //
 //   $ ./gsqsolve --solution-counts | sort -n | less
 //
+// This takes a while, so it also accepts "--threads".  The output comes
+// out in the same order no matter how many threads are used.
+//
+// That order numbers every roll from 0 to 62,207, and a roll can be
+// picked out by its number:
+//
+//   $ ./gsqsolve --roll-index 39425
+//
+// ...solves the same board as the example above, and
+// "--roll-index c4 b1 e5 a6 d2 c5 a5" prints that roll's number.
+//
+// "--verify-all" and "--solution-counts" can be split up to run on
+// several machines at once.  With "--shard 2/5", for example, they only
+// go through the second fifth of the rolls.  Afterwards the outputs of all
+// of the shards can be put back together (in any order) with:
+//
+//   $ ./gsqsolve --merge counts.1 counts.2 counts.3 counts.4 counts.5
+//
+// ...which checks that every roll is there exactly once and prints the
+// same thing a single "--solution-counts" would have.
+//
+// A board that is just another one turned around or flipped over has the
+// same solutions, turned the same way.  So these only search one board
+// out of each such set, which is 28,276 boards rather than all 62,208
+// rolls.  Use "--no-symmetry" to make them search every one.
+//
+// The same counts also come out of:
+//
+//   $ ./gsqsolve --tiling-counts
+//
+// ...which works the other way around.  Instead of searching each board,
+// it goes through every way the pieces (other than the single square) can
+// be put down on an empty board without overlapping, and tallies up which
+// boards each of those solves.  That's quicker than searching each roll,
+// and it finds out about every possible set of 7 blockers along the way.
+// "--tiling-counts all" prints the counts for all 8,347,680 of them.
+//
+// Those can also be saved in a file that is quick to look things up in:
+//
+//   $ ./gsqsolve --threads 0 --census census.bin
+//
+// ...and then when asked to solve a board that isn't a dice roll,
+// "--use-census census.bin" makes it check the file first.  That way it
+// can say right away when there is no solution, rather than searching,
+// and with "--solutions" it knows when it has printed the last one.
+//
+// The answers that are built in for every dice roll can be saved to a
+// file too, so that several programs can share one copy of them:
+//
+//   $ ./gsqsolve --build-db rolls.db
+//   $ ./gsqsolve --db rolls.db --threads 0 --serve /tmp/gsqsolve.sock
+//
+// With "--db" dice rolls get looked up in that file, which is mapped
+// straight into memory, instead of in the built-in table.
+//
+// There are several search algorithms to choose from.  By default pieces
+// are placed in a fixed order, but "--engine cell-driven" instead always
+// fills the lowest-numbered empty square next, and "--engine dlx" uses
+// Knuth's dancing links.  They all find the same number of solutions, so
+// one can be used to cross-check another.  "--engine memo" searches the
+// same way as "cell-driven", but when counting solutions it remembers how
+// many ways there were to finish off each partly-filled board it came
+// across.  Lots of boards pass through the same states, so this makes
+// "--solution-counts" several times faster (at the cost of 64MB of memory).
+//
+// "--engine simd" is the same as the default, but for "--verify-all" and
+// "--batch" it solves 8 or 16 boards at a time using the CPU's AVX2 or
+// AVX-512 vector instructions (if it has them; otherwise it solves them
+// one at a time as usual).
+//
+// "--engine narrowing" also places the pieces in the default order, but
+// every time it places one it weeds out the placements of the pieces still
+// to come that no longer fit.  It finds the same solutions, and counts them
+// faster.
+//
+// Adding "--stats" when solving a board, or with "--verify-all" or
+// "--solution-counts", prints a summary of what the search did to stderr:
+// for each piece how many placements it tested, how many of those didn't
+// overlap what was already on the board, and how many it actually placed,
+// followed by how many pieces were on the board each time it hit a dead
+// end.  This implies "--no-table".  Searches that aren't asked for
+// statistics are compiled separately, so they don't pay anything for them.
+//
+// Programs that need to solve lots of boards can instead keep a server
+// running and send it requests over a Unix domain socket:
+//
+//   $ ./gsqsolve --threads 0 --serve /tmp/gsqsolve.sock
+//
+// Each request is a line listing the seven positions.  The reply is the
+// same image it would have printed, followed by a blank line.  With
+// "--format compact" the reply is instead a single line of 36 characters,
+// one per square, giving the number of the piece there or '.' for a
+// blocker.  If the boards are all known up front they can also be fed in
+// on stdin, one per line, and the replies come out on stdout in the same
+// order:
+//
+//   $ ./gsqsolve --threads 0 --batch < boards.txt
+//
+// Programs that would rather not parse either of those can ask for
+// "--format ndjson", which writes a line of JSON for each board giving its
+// blockers (as a bitmask) and where each piece went, or "--format bin",
+// which writes a 16-byte record for each board: the blockers as a
+// little-endian 64-bit mask, and then for each of line4, square2_2,
+// lblock3, zblock, tblock, line3, lblock2 and line2 a byte giving its
+// index into that piece's array of placements.  If there's no solution
+// those bytes are all 255, and a line that couldn't be parsed gets 16
+// bytes of 255.
+//
+// C++ programs can also link the solver in directly instead of running it:
+// "make libgsqsolve.a" builds it as a library, and gsqsolve.h describes
+// how to call it.  For other languages, "make libgsqsolve.so" builds a
+// shared library with the plain C interface in gsqsolve-c.h.
+//
 // Finally, if you just want to see it solve a random board position:
 //
 //   $ ./gsqsolve --random
@@ -36,12 +161,46 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstdint>
+#include <cstddef>
 #include <cassert>
 #include <cstring>
 #include <ctime>
+#include <cerrno>
 #include <array>
 #include <span>
+#include <optional>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <bit>
+#include <string_view>
+#include <charconv>
+#include <type_traits>
+#include <coroutine>
+#include <utility>
+#include <unordered_map>
+#include <csignal>
 #include <sysexits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#include "gsqsolve.h"
+#include "gsqsolve-c.h"
 
 namespace {
 
@@ -165,6 +324,34 @@ MAKE_UNIQUE_FACES(5);
 MAKE_UNIQUE_FACES(6);
 #undef MAKE_UNIQUE_FACES
 
+// Total number of distinct rolls that the dice can produce
+static constexpr unsigned num_possible_rolls =
+	unique_faces_0.size() * unique_faces_1.size() * unique_faces_2.size() * unique_faces_3.size() *
+	unique_faces_4.size() * unique_faces_5.size() * unique_faces_6.size();
+
+// Produce the roll at a given position in the iteration order used by the
+// nested "unique_faces_<n>" loops (i.e. the last die varies fastest).  This
+// lets us hand out ranges of the roll space to different threads.
+[[nodiscard]] static auto constexpr roll_from_index(unsigned idx) noexcept -> board_bitmask_t
+{
+	assert(idx < num_possible_rolls);
+	board_bitmask_t rv = 0;
+#define ROLL_DIGIT(n)							\
+	do {								\
+		rv |= unique_faces_##n[idx % unique_faces_##n.size()];	\
+		idx /= static_cast<unsigned>(unique_faces_##n.size());	\
+	} while (0)
+	ROLL_DIGIT(6);
+	ROLL_DIGIT(5);
+	ROLL_DIGIT(4);
+	ROLL_DIGIT(3);
+	ROLL_DIGIT(2);
+	ROLL_DIGIT(1);
+	ROLL_DIGIT(0);
+#undef ROLL_DIGIT
+	return rv;
+}
+
 // Given a bitmask with (up to) 7 bits set, check that it could have
 // actually resulted from a dice roll
 [[nodiscard]] static auto blockers_are_valid_roll(board_bitmask_t blockers)
@@ -183,8 +370,132 @@ MAKE_UNIQUE_FACES(6);
 	return saw_die == 0b1'111'111;
 }
 
+// The reverse of roll_from_index().  Every square of the board appears on
+// exactly one die, so each square tells us which die it came from and which
+// of that die's unique faces it was.
+struct die_face {
+	unsigned char die;
+	unsigned char face;
+};
+
+[[nodiscard]] static auto consteval make_die_face_of_square() noexcept -> std::array<die_face, 36>
+{
+	std::array<die_face, 36> rv {};
+#define ADD_DIE(n)									\
+	for (unsigned face = 0; face < unique_faces_##n.size(); face++) {		\
+		auto const square = std::countr_zero(unique_faces_##n[face]);		\
+		rv[static_cast<unsigned>(square)] = { n, static_cast<unsigned char>(face) };	\
+	}
+	ADD_DIE(0)
+	ADD_DIE(1)
+	ADD_DIE(2)
+	ADD_DIE(3)
+	ADD_DIE(4)
+	ADD_DIE(5)
+	ADD_DIE(6)
+#undef ADD_DIE
+	return rv;
+}
+static constexpr auto die_face_of_square = make_die_face_of_square();
+
+static constexpr std::array<unsigned, 7> num_unique_faces = {
+	unique_faces_0.size(), unique_faces_1.size(), unique_faces_2.size(), unique_faces_3.size(),
+	unique_faces_4.size(), unique_faces_5.size(), unique_faces_6.size(),
+};
+
+[[nodiscard]] static auto constexpr roll_index_of(board_bitmask_t blockers) noexcept -> unsigned
+{
+	std::array<unsigned, 7> faces {};
+	for (auto bits = blockers; bits != 0; bits &= bits - 1) {
+		auto const& df = die_face_of_square[static_cast<unsigned>(std::countr_zero(bits))];
+		faces[df.die] = df.face;
+	}
+	unsigned idx = 0;
+	for (unsigned die = 0; die < faces.size(); die++)
+		idx = idx * num_unique_faces[die] + faces[die];
+	assert(roll_from_index(idx) == blockers);
+	return idx;
+}
+
+// Rolls aren't the only boards we keep results for: the tiling counts and
+// the census cover every possible set of 7 blockers.  Those are numbered
+// from 0 to C(36, 7) - 1 instead, using the binomial coefficients.
+
+// C(n, k) for every number of squares we need to choose from the board
+[[nodiscard]] static auto consteval make_binomial_table() noexcept -> std::array<std::array<std::uint32_t, 9>, 37>
+{
+	std::array<std::array<std::uint32_t, 9>, 37> rv {};
+	for (unsigned n = 0; n < rv.size(); n++) {
+		rv[n][0] = 1;
+		for (unsigned k = 1; k < rv[n].size() and k <= n; k++)
+			rv[n][k] = rv[n - 1][k - 1] + ((k < n) ? rv[n - 1][k] : 0);
+	}
+	return rv;
+}
+static constexpr auto binomial = make_binomial_table();
+
+// Where a set of squares comes among all of the sets with the same number
+// of squares, when they're listed in order of their bitmasks
+// (colexicographic order)
+[[nodiscard]] static constexpr auto rank_of_squares(board_bitmask_t squares) noexcept -> std::uint32_t
+{
+	assert((squares >> 36) == 0);
+	std::uint32_t rank = 0;
+	unsigned i = 1;
+	for (auto bits = squares; bits != 0; bits &= bits - 1)
+		rank += binomial[static_cast<unsigned>(std::countr_zero(bits))][i++];
+	return rank;
+}
+
+// The opposite of rank_of_squares(): the set of 'num_squares' squares
+// that comes at position 'rank'
+[[nodiscard]] static constexpr auto squares_of_rank(std::uint32_t rank, unsigned num_squares) noexcept -> board_bitmask_t
+{
+	assert(num_squares < binomial[36].size() and rank < binomial[36][num_squares]);
+	board_bitmask_t squares = 0;
+	unsigned square = 36;
+	for (auto i = num_squares; i > 0; i--) {
+		// The highest square left is the largest one whose
+		// binomial coefficient still fits in the rank
+		do
+			square--;
+		while (binomial[square][i] > rank);
+		rank -= binomial[square][i];
+		squares |= static_cast<board_bitmask_t>(1) << square;
+	}
+	return squares;
+}
+
+// The next larger bitmask with the same number of squares (Gosper's hack),
+// which steps through sets of squares in the order rank_of_squares() counts
+[[nodiscard]] static constexpr auto next_set_of_squares(board_bitmask_t squares) noexcept -> board_bitmask_t
+{
+	auto const lowest = squares & -squares;
+	auto const ripple = squares + lowest;
+	return ripple | (((squares ^ ripple) >> 2) / lowest);
+}
+
+// Check at compile time that the two kinds of ranking above really are
+// the inverse of each other.  Trying every board would take the compiler
+// too long, so this tries a spread of them from the first to the last.
+[[nodiscard]] static auto consteval rankings_round_trip() noexcept -> bool
+{
+	for (unsigned idx = 0; idx < num_possible_rolls; idx += 61)
+		if (roll_index_of(roll_from_index(idx)) != idx)
+			return false;
+	for (std::uint32_t rank = 0; rank < binomial[36][7]; rank += 997) {
+		auto const squares = squares_of_rank(rank, 7);
+		if (std::popcount(squares) != 7 or rank_of_squares(squares) != rank or
+		    rank_of_squares(next_set_of_squares(squares)) != rank + 1)
+			return false;
+	}
+	return roll_index_of(roll_from_index(num_possible_rolls - 1)) == num_possible_rolls - 1 and
+	       squares_of_rank(binomial[36][7] - 1, 7) == (static_cast<board_bitmask_t>(0x7F) << 29);
+}
+static_assert(rankings_round_trip());
+
 // Generate a bitmask of "blocker" pieces by rolling the dice
-[[nodiscard]] static auto random_blockers() noexcept -> board_bitmask_t
+[[maybe_unused]] [[nodiscard]] static auto random_blockers() noexcept -> board_bitmask_t
 {
 	board_bitmask_t used = 0;
 
@@ -526,6 +837,19 @@ enum class piece_id {
 	blockers,	// White round piece
 };
 
+// Names for each piece, indexed by piece_id
+static constexpr std::array<char const *, 9> piece_names = {
+	"single_block",
+	"line2",
+	"line3",
+	"line4",
+	"square2_2",
+	"lblock2",
+	"lblock3",
+	"zblock",
+	"tblock",
+};
+
 static constexpr std::array<char const *, 10> piece_rendering = {
 #if 1
 #  define RENDER_BLOCK(color_num)	"\033[" #color_num "m \033[0m"
@@ -545,10 +869,506 @@ static constexpr std::array<char const *, 10> piece_rendering = {
 	"\xE2\x97\x8F",
 };
 
+// One character per square for --format compact: the pieces are
+// numbered in the same order as piece_id and the blockers are '.'
+static constexpr std::array<char, 10> compact_rendering = {
+	'1', '2', '3', '4', '5', '6', '7', '8', '9', '.',
+};
+
+// How solved boards get written out
+enum class output_format {
+	ansi,		// six lines of colored blocks
+	compact,	// a single line of 36 characters
+	bin,		// a bin_record_size byte record
+	ndjson,		// a line of JSON
+};
+
+// A "--format bin" record is the blockers as a little-endian 64-bit mask,
+// followed by the index of each of the placed_pieces' placement within its
+// placements_of_piece array, a byte each.  A board with no solution gets
+// no_solution_index for all of them, and a request that couldn't be
+// parsed gets a record that's nothing but no_solution_index.
+static constexpr std::size_t bin_record_size = 16;
+static constexpr std::uint8_t no_solution_index = 0xFF;
+
+// Every board square that a piece can occupy (i.e. all of them)
+// This is what we use for the single-square piece when we do need to
+// place it explicitly.
+[[nodiscard]] static auto consteval make_single_block() noexcept -> std::array<board_bitmask_t, 36>
+{
+	std::array<board_bitmask_t, 36> rv {};
+	for (unsigned row = 0; row < 6; row++)
+		for (unsigned col = 0; col < 6; col++)
+			rv[row * 6 + col] = sbit(row, col);
+	return rv;
+}
+static constexpr auto single_block = make_single_block();
+
+// The array of possible placements for each piece, indexed by piece_id
+static constexpr std::array<std::span<board_bitmask_t const>, 9> placements_of_piece = {
+	single_block,
+	line2,
+	line3,
+	line4,
+	square2_2,
+	lblock2,
+	lblock3,
+	zblock,
+	tblock,
+};
+
+// The pieces that board::solve() places, in the order it places them.
+// Solutions get stored compactly as the index of each of these pieces'
+// placement within its array, in this order.
+static constexpr std::array<piece_id, 8> placed_pieces = {
+	piece_id::line4,
+	piece_id::square2_2,
+	piece_id::lblock3,
+	piece_id::zblock,
+	piece_id::tblock,
+	piece_id::line3,
+	piece_id::lblock2,
+	piece_id::line2,
+};
+using placement_indices_t = std::array<std::uint8_t, placed_pieces.size()>;
+static_assert(std::is_same_v<placement_indices_t, gsqsolve::placement_indices_t>);
+static_assert(bin_record_size == sizeof(board_bitmask_t) + sizeof(placement_indices_t));
+
+// The most that board::render() can write for one board.  In the ANSI
+// format that's six rows of the longest of the piece_rendering strings plus
+// a newline each.  The JSON is something like:
+//
+//   {"blockers":...,"placements":{"line4":12,...},"board":"..."}
+static constexpr std::size_t max_rendered_board_size = [] {
+	std::size_t longest = 0;
+	for (auto const r : piece_rendering)
+		longest = std::max(longest, std::char_traits<char>::length(r));
+	std::size_t json = std::char_traits<char>::length("{\"blockers\":18446744073709551615,\"placements\":{},\"board\":\"\"}\n") + 36;
+	for (auto const piece : placed_pieces)
+		json += std::char_traits<char>::length(piece_names[static_cast<unsigned>(piece)]) + std::char_traits<char>::length("\"\":255,");
+	return std::max(6 * (6 * longest + 1), json);
+}();
+
+// The cell-driven search treats the board as an exact-cover problem: each
+// of the 36 squares has to be covered exactly once, and so does each of
+// the 9 pieces.  To make that cheap, a placement gets an extra bit above
+// the 36 board squares that says which piece it is.  A single AND against
+// the "used" mask then checks both for overlapping another piece and for
+// trying to use the same piece twice.
+static constexpr unsigned piece_bit_shift = 36;
+static constexpr board_bitmask_t all_squares = 0xF'FFFF'FFFFull;
+static constexpr board_bitmask_t all_squares_and_pieces = (static_cast<board_bitmask_t>(1) << (piece_bit_shift + 9)) - 1;
+
+// Every placement of every piece, grouped by the lowest-numbered board
+// square that each one covers.  If every square below some square 'n' is
+// already full then the only placements that can possibly fill 'n' are
+// the ones listed under at[n].
+struct cell_placements {
+	// The most placements any square can have is one for each orientation
+	// of each piece: 1 + 2 + 2 + 2 + 1 + 4 + 8 + 4 + 4
+	static constexpr unsigned max_per_cell = 28;
+
+	std::array<std::array<board_bitmask_t, max_per_cell>, 36> at;
+	std::array<unsigned char, 36> count;
+
+	consteval auto add(std::span<board_bitmask_t const> shape, piece_id piece) noexcept -> void
+	{
+		auto const piece_bit = static_cast<board_bitmask_t>(1) << (piece_bit_shift + static_cast<unsigned>(piece));
+		for (auto const e : shape) {
+			auto const cell = static_cast<unsigned>(std::countr_zero(e));
+			at[cell][count[cell]++] = e | piece_bit;
+		}
+	}
+
+	[[nodiscard]] auto constexpr placements_at(unsigned cell) const noexcept -> std::span<board_bitmask_t const>
+	{
+		return std::span<board_bitmask_t const>(at[cell].data(), count[cell]);
+	}
+};
+
+// Bigger pieces are listed first, for the same reasons the loop nest
+// places them first.  The single square goes last.
+[[nodiscard]] static auto consteval make_cell_placements() noexcept -> cell_placements
+{
+	cell_placements rv {};
+	rv.add(line4, piece_id::line4);
+	rv.add(square2_2, piece_id::square2_2);
+	rv.add(lblock3, piece_id::lblock3);
+	rv.add(zblock, piece_id::zblock);
+	rv.add(tblock, piece_id::tblock);
+	rv.add(line3, piece_id::line3);
+	rv.add(lblock2, piece_id::lblock2);
+	rv.add(line2, piece_id::line2);
+	rv.add(single_block, piece_id::single_block);
+	return rv;
+}
+static constexpr auto placements_by_cell = make_cell_placements();
+
+// The board looks the same after it's rotated or flipped over, and so does
+// the set of places each piece can go, so turning a solved board around
+// gives a solution for the turned-around blockers.  Boards that are the same
+// apart from that only need to be searched once.
+//
+// There are 8 of these symmetries: symmetry 'k' turns the board clockwise
+// by (k & 3) quarter turns and then, if (k & 4) is set, mirrors it left to
+// right.  Symmetry 0 leaves the board alone.
+static constexpr unsigned num_symmetries = 8;
+
+// The symmetry that undoes each one.  Mirroring twice gets back to where
+// you started, so only the plain rotations need to be turned the other way.
+static constexpr std::array<std::uint8_t, num_symmetries> inverse_symmetry = { 0, 3, 2, 1, 4, 5, 6, 7 };
+
+// Transforming a bitmask is done a byte at a time: for each byte of the
+// mask there is a table giving where each of those 8 squares ends up
+// under each symmetry, and we OR together what the 5 bytes look up.
+using symmetry_table_t = std::array<std::array<board_bitmask_t, 256>, 5>;
+
+[[nodiscard]] static auto consteval make_symmetry_tables() noexcept -> std::array<symmetry_table_t, num_symmetries>
+{
+	std::array<symmetry_table_t, num_symmetries> rv {};
+	for (unsigned k = 0; k < num_symmetries; k++) {
+		for (unsigned byte = 0; byte < 5; byte++) {
+			for (unsigned value = 0; value < 256; value++) {
+				board_bitmask_t out = 0;
+				for (unsigned bit = 0; bit < 8; bit++) {
+					auto const square = byte * 8 + bit;
+					if ((value & (1u << bit)) == 0 or square >= 36)
+						continue;
+					auto row = square / 6;
+					auto col = square % 6;
+					for (unsigned turn = 0; turn < (k & 3); turn++) {
+						auto const old_row = row;
+						row = col;
+						col = 5 - old_row;
+					}
+					if ((k & 4) != 0)
+						col = 5 - col;
+					out |= sbit(row, col);
+				}
+				rv[k][byte][value] = out;
+			}
+		}
+	}
+	return rv;
+}
+static constexpr auto symmetry_tables = make_symmetry_tables();
+
+[[nodiscard]] static constexpr auto transform_board(board_bitmask_t mask, unsigned symmetry) noexcept -> board_bitmask_t
+{
+	assert((mask & ~all_squares) == 0);
+	assert(symmetry < num_symmetries);
+	auto const& t = symmetry_tables[symmetry];
+	return t[0][mask & 0xFF] | t[1][(mask >> 8) & 0xFF] | t[2][(mask >> 16) & 0xFF] |
+	       t[3][(mask >> 24) & 0xFF] | t[4][mask >> 32];
+}
+
+// All of this depends on every transformed placement of a piece also
+// being in that piece's array
+[[nodiscard]] static auto consteval placements_are_symmetric() noexcept -> bool
+{
+	for (auto const placements : placements_of_piece)
+		for (auto const t : placements)
+			for (unsigned k = 0; k < num_symmetries; k++)
+				if (std::find(placements.begin(), placements.end(), transform_board(t, k)) == placements.end())
+					return false;
+	for (unsigned k = 0; k < num_symmetries; k++)
+		if (transform_board(transform_board(sbit(0, 1) | sbit(2, 3), k), inverse_symmetry[k]) != (sbit(0, 1) | sbit(2, 3)))
+			return false;
+	return true;
+}
+static_assert(placements_are_symmetric());
+
+// The smallest of the 8 transformed versions of a set of blockers.  Boards
+// with the same canonical form have the same number of solutions.  Also
+// sets 'symmetry' to the one that turns 'blockers' into that form.
+[[nodiscard]] static auto canonical_blockers(board_bitmask_t blockers, unsigned& symmetry) noexcept -> board_bitmask_t
+{
+	auto best = blockers;
+	symmetry = 0;
+	for (unsigned k = 1; k < num_symmetries; k++) {
+		auto const t = transform_board(blockers, k);
+		if (t < best) {
+			best = t;
+			symmetry = k;
+		}
+	}
+	return best;
+}
+
+// Which search algorithm board::solve() and board::count_solutions() use
+enum class solver_engine {
+	loop_nest,	// place pieces in a fixed order (SOLVE_BOARD below)
+	cell_driven,	// always cover the lowest empty square next
+	dlx,		// exact cover using dancing links
+	memo,		// cell_driven, but counting reuses answers it's seen before
+	simd,		// loop_nest, but on lots of boards at once (lockstep_solver)
+	narrowing,	// loop_nest, but narrowing down the later pieces' lists as it goes
+};
+
+// The name of each engine, as given to "--engine"
+struct engine_name {
+	char const *name;
+	solver_engine engine;
+};
+static constexpr std::array<engine_name, 6> engine_names = {{
+	{ "loop-nest", solver_engine::loop_nest },
+	{ "cell-driven", solver_engine::cell_driven },
+	{ "dlx", solver_engine::dlx },
+	{ "memo", solver_engine::memo },
+	{ "simd", solver_engine::simd },
+	{ "narrowing", solver_engine::narrowing },
+}};
+
+// Which piece a placement from placements_by_cell is for
+[[nodiscard]] static constexpr auto piece_of_placement(board_bitmask_t placement) noexcept -> piece_id
+{
+	return static_cast<piece_id>(std::countr_zero(placement >> piece_bit_shift));
+}
+
+// The memo engine's record of how many ways there are to finish off a
+// partly-filled board.  The cell-driven search's "used" mask (see
+// piece_bit_shift) says both which squares are filled and which pieces are
+// left, and that's all the rest of the search depends on, so it makes a
+// complete key.  Different boards can end up in the same state, so one of
+// these can be shared between boards and threads.
+//
+// The table has a fixed size and each entry is a single 64-bit word that
+// holds both the key and the count, so it can be read and written with
+// plain atomic loads and stores and no locking.  When two states want the
+// same entry the newer one just replaces the older one.
+class memo_table {
+    public:
+	explicit memo_table(unsigned log2_entries) noexcept
+		: shift_(64 - log2_entries)
+		, entries_(static_cast<std::size_t>(1) << log2_entries)
+	{
+	}
+
+	[[nodiscard]] auto lookup(board_bitmask_t used, unsigned& count) const noexcept -> bool
+	{
+		auto const entry = entries_[index_(used)].load(std::memory_order_relaxed);
+		if ((entry & all_squares_and_pieces) != used)
+			return false;
+		count = static_cast<unsigned>(entry >> count_shift);
+		return true;
+	}
+
+	auto store(board_bitmask_t used, unsigned count) noexcept -> void
+	{
+		// 'used' always has some squares filled, so an all-zero
+		// entry never matches anything
+		assert(used != 0 and (used & ~all_squares_and_pieces) == 0);
+		if (count > max_count)
+			[[unlikely]] return;
+		entries_[index_(used)].store(used | (static_cast<std::uint64_t>(count) << count_shift), std::memory_order_relaxed);
+	}
+
+    private:
+	static constexpr unsigned count_shift = piece_bit_shift + 9;
+	static constexpr unsigned max_count = (1u << (64 - count_shift)) - 1;
+
+	unsigned const shift_;
+	std::vector<std::atomic<std::uint64_t>> entries_;
+
+	[[nodiscard]] auto index_(board_bitmask_t used) const noexcept -> std::size_t
+	{
+		return static_cast<std::size_t>((used * 0x9E37'79B9'7F4A'7C15ull) >> shift_);
+	}
+};
+
+// How big a memo_table count_solutions() uses when the board wasn't given
+// one to share.  Each entry takes 8 bytes.
+static constexpr unsigned lone_memo_log2_entries = 16;
+
+// The searches can optionally keep statistics about how much work they
+// did.  They take one of these as a template parameter and call it as they
+// go: tested() for each candidate placement they look at, passed() if it
+// doesn't overlap anything already on the board, placed() if it actually
+// gets placed, and solved() when every piece is down.  Normally that's
+// no_search_stats, which does nothing at all and so compiles away entirely.
+struct no_search_stats {
+	static constexpr bool enabled = false;
+
+	auto begin() noexcept -> void { }
+	auto tested(piece_id) noexcept -> void { }
+	auto passed(piece_id) noexcept -> void { }
+	auto placed(piece_id, unsigned /* depth */) noexcept -> void { }
+	auto solved() noexcept -> void { }
+	auto reused(unsigned /* solutions */) noexcept -> void { }
+	auto end() noexcept -> void { }
+};
+
+class search_stats {
+    public:
+	static constexpr bool enabled = true;
+
+	// How many boards were searched, and how many solutions were found
+	std::uint64_t boards = 0;
+	std::uint64_t solutions = 0;
+	// How many times the memo engine didn't have to search part of a
+	// board since it already knew the answer
+	std::uint64_t reuses = 0;
+	// For each piece, indexed by piece_id: how many of its placements
+	// got tested, how many of those didn't overlap anything, and how
+	// many were actually placed.  Fewer get placed than pass when the
+	// search prunes ones that leave a part of the board nothing can
+	// fill.  Each placement is a node in the search tree.
+	std::array<std::uint64_t, 9> tests{};
+	std::array<std::uint64_t, 9> passes{};
+	std::array<std::uint64_t, 9> nodes{};
+	// How many times the search ran out of things to place next,
+	// indexed by how many pieces were on the board at that point
+	std::array<std::uint64_t, 10> dead_ends{};
+
+	auto begin() noexcept -> void
+	{
+		boards++;
+		leaf_pending_ = true;
+		leaf_depth_ = 0;
+	}
+
+	auto tested(piece_id piece) noexcept -> void
+	{
+		tests[static_cast<unsigned>(piece)]++;
+	}
+
+	auto passed(piece_id piece) noexcept -> void
+	{
+		passes[static_cast<unsigned>(piece)]++;
+	}
+
+	// 'depth' is how many pieces are on the board counting this one
+	auto placed(piece_id piece, unsigned depth) noexcept -> void
+	{
+		assert(depth > 0 and depth < dead_ends.size());
+		nodes[static_cast<unsigned>(piece)]++;
+		// The search is depth-first, so if this isn't deeper than the
+		// last piece placed then nothing went on top of that one
+		if (leaf_pending_ and depth <= leaf_depth_)
+			dead_ends[leaf_depth_]++;
+		leaf_pending_ = true;
+		leaf_depth_ = depth;
+	}
+
+	auto solved() noexcept -> void
+	{
+		solutions++;
+		leaf_pending_ = false;
+	}
+
+	// The memo engine already knew how many solutions are below the last
+	// piece placed, so it didn't search any further
+	auto reused(unsigned num_solutions) noexcept -> void
+	{
+		reuses++;
+		solutions += num_solutions;
+		leaf_pending_ = false;
+	}
+
+	auto end() noexcept -> void
+	{
+		if (leaf_pending_)
+			dead_ends[leaf_depth_]++;
+		leaf_pending_ = false;
+	}
+
+	auto operator+=(search_stats const& other) noexcept -> search_stats&
+	{
+		boards += other.boards;
+		solutions += other.solutions;
+		reuses += other.reuses;
+		for (unsigned i = 0; i < nodes.size(); i++) {
+			tests[i] += other.tests[i];
+			passes[i] += other.passes[i];
+			nodes[i] += other.nodes[i];
+		}
+		for (unsigned i = 0; i < dead_ends.size(); i++)
+			dead_ends[i] += other.dead_ends[i];
+		return *this;
+	}
+
+    private:
+	// The last piece placed, which might turn out to have been a dead end
+	bool leaf_pending_ = false;
+	unsigned leaf_depth_ = 0;
+};
+
+// A coroutine that hands back a T each time it does "co_yield", which can be
+// gone through with a range-for.  Nothing runs until the first value is
+// asked for, and then only up to the next "co_yield", so the caller can
+// stop whenever it likes.  (C++23 has std::generator, but we don't get to
+// use that yet.)
+template<typename T>
+class generator {
+    public:
+	struct promise_type {
+		T const *current = nullptr;
+
+		auto get_return_object() noexcept -> generator { return generator(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		auto initial_suspend() noexcept -> std::suspend_always { return {}; }
+		auto final_suspend() noexcept -> std::suspend_always { return {}; }
+		// What gets yielded lives in the coroutine until it resumes,
+		// so there's no need to copy it
+		auto yield_value(T const& value) noexcept -> std::suspend_always
+		{
+			current = &value;
+			return {};
+		}
+		auto return_void() noexcept -> void {}
+		[[noreturn]] auto unhandled_exception() noexcept -> void { abort(); }
+	};
+
+	class iterator {
+	    public:
+		explicit iterator(std::coroutine_handle<promise_type> handle) noexcept : handle_(handle) {}
+		auto operator*() const noexcept -> T const& { return *handle_.promise().current; }
+		auto operator++() noexcept -> iterator&
+		{
+			handle_.resume();
+			return *this;
+		}
+		auto operator==(std::default_sentinel_t) const noexcept -> bool { return handle_.done(); }
+	    private:
+		std::coroutine_handle<promise_type> handle_;
+	};
+
+	generator(generator&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+	generator(generator const&) = delete;
+	auto operator=(generator const&) -> generator& = delete;
+	~generator()
+	{
+		if (handle_)
+			handle_.destroy();
+	}
+
+	// Run up to the first value.  This can only be called once.
+	[[nodiscard]] auto begin() noexcept -> iterator
+	{
+		handle_.resume();
+		return iterator(handle_);
+	}
+	[[nodiscard]] auto end() const noexcept -> std::default_sentinel_t { return {}; }
+
+    private:
+	explicit generator(std::coroutine_handle<promise_type> handle) noexcept : handle_(handle) {}
+
+	std::coroutine_handle<promise_type> handle_;
+};
+
+// Where each of the placed_pieces went, in that order
+using placement_masks_t = std::array<board_bitmask_t, placed_pieces.size()>;
+
+struct narrowing_lists;
+
 class board {
     public:
-	explicit board(board_bitmask_t blockers) noexcept
+	// The memo engine keeps its answers in 'memo', which can be shared
+	// with other boards.  If there isn't one, count_solutions() uses a
+	// small one that belongs to the thread.
+	explicit board(board_bitmask_t blockers, solver_engine engine = solver_engine::loop_nest, memo_table *memo = nullptr) noexcept
 		: blockers_(blockers)
+		, engine_(engine)
+		, memo_(memo)
 		// All of the other members are only set in solve()
 	{
 	}
@@ -561,13 +1381,48 @@ class board {
 	// Count all of the possible solutions for a board position
 	[[nodiscard]] auto count_solutions() noexcept -> unsigned;
 
-	// Print out the board in ANSI color
-	auto print() const noexcept -> void;
+	// Go through the solutions one at a time, in the order the loop nest
+	// finds them, without working out any more of them than are asked
+	// for.  While each one is being looked at the board is also filled
+	// in with it, so it can be printed.  The board has to outlive the
+	// generator.
+	[[maybe_unused]] [[nodiscard]] auto solutions() noexcept -> generator<placement_masks_t>;
+
+	// The same, but also collecting statistics about the search into
+	// 'stats' (see search_stats)
+	template<typename STATS>
+	[[nodiscard]] auto solve(STATS& stats) noexcept -> bool;
+	template<typename STATS>
+	[[nodiscard]] auto count_solutions(STATS& stats) noexcept -> unsigned;
+
+	// Print out the board, by default in ANSI color
+	[[maybe_unused]] auto print(output_format format = output_format::ansi) const noexcept -> void;
+
+	// Append the same thing print() would write to 'out'
+	auto render(std::string& out, output_format format = output_format::ansi) const noexcept -> void;
+
+	// Write the same thing into 'out', which must have room for at least
+	// max_rendered_board_size bytes, and return how many bytes it took
+	[[nodiscard]] auto render(std::span<char> out, output_format format = output_format::ansi) const noexcept -> std::size_t;
+
+	// Describe a solved board by where each of the placed_pieces went,
+	// as an index into that piece's placements_of_piece array
+	[[nodiscard]] auto placement_indices() const noexcept -> placement_indices_t;
+
+	// Fill in the board from a solution saved by placement_indices()
+	[[maybe_unused]] auto set_placements(placement_indices_t const& indices) noexcept -> void;
+
+	// Fill in the board from 'solved', a solution to the board that this
+	// one turns into under 'symmetry'
+	auto set_transformed(board const& solved, unsigned symmetry) noexcept -> void;
 
     private:
 	// These are the 7 "blocker" spaces that the board starts with.
 	// This value gets set in the constructor.
 	board_bitmask_t const blockers_;
+	// Which search to use
+	solver_engine const engine_;
+	memo_table *const memo_;
 	// The first blocks we place are the ones that take up four
 	// spots.  This way we get as many blocks used up as quickly
 	// as possible, making it more likely we can find a conflict early.
@@ -591,8 +1446,73 @@ class board {
 	// all of the other blocks.  The one remaining empty block is then
 	// implicitly where the single-square must go.
 
-	// Given a location at the board, which piece got placed there
-	auto piece_at(unsigned row, unsigned col) const noexcept -> piece_id;
+	// Where each piece's placement gets recorded, indexed by piece_id.
+	// The single-square piece isn't recorded anywhere.
+	static constexpr std::array<board_bitmask_t board::*, 9> piece_member_ = {
+		nullptr,
+		&board::line2_,
+		&board::line3_,
+		&board::line4_,
+		&board::square2_2_,
+		&board::lblock2_,
+		&board::lblock3_,
+		&board::zblock_,
+		&board::tblock_,
+	};
+
+	// solve() and count_solutions() without the calls to STATS::begin()
+	// and STATS::end(), which pick an engine's implementation
+	template<typename STATS>
+	[[nodiscard]] auto solve_with_engine_(STATS& stats) noexcept -> bool;
+	template<typename STATS>
+	[[nodiscard]] auto count_solutions_with_engine_(STATS& stats) noexcept -> unsigned;
+
+	// Implementations of solve() and count_solutions() for each engine
+	template<typename STATS>
+	[[nodiscard]] auto solve_loop_nest_(STATS& stats) noexcept -> bool;
+	template<typename STATS>
+	[[nodiscard]] auto count_solutions_loop_nest_(STATS& stats) noexcept -> unsigned;
+
+	// Cell-driven search: find the lowest empty square and try each
+	// placement that fills it.  'used' holds both the filled squares and
+	// the pieces already placed (see piece_bit_shift) and 'placed' is a
+	// stack of the placements made so far.  Calls on_solved() for each
+	// solution found and stops as soon as that returns true.
+	template<typename STATS, typename F>
+	[[nodiscard]] auto cover_lowest_square_(board_bitmask_t used, board_bitmask_t *placed, STATS& stats, F const& on_solved) noexcept -> bool;
+
+	// The memo engine's version of the cell-driven search, which returns
+	// the number of solutions
+	template<typename STATS>
+	[[nodiscard]] auto count_covers_memo_(board_bitmask_t used, memo_table& memo, STATS& stats) noexcept -> unsigned;
+
+	// Narrowing search: see narrowing_lists.  Calls on_solved() for each
+	// solution found and stops as soon as that returns true.
+	template<typename STATS, typename F>
+	[[nodiscard]] auto narrowing_search_(STATS& stats, F const& on_solved) noexcept -> bool;
+
+	// One level of it: place placed_pieces[LEVEL] and then everything
+	// after it, trying only the placements in 'lists' (which all fit on
+	// the board so far).  'used' holds the filled squares.
+	template<unsigned LEVEL, typename STATS, typename F>
+	[[nodiscard]] auto narrow_(narrowing_lists *lists, board_bitmask_t used, STATS& stats, F const& on_solved) noexcept -> bool;
+
+	// Copy the placements made by the cell-driven search into the
+	// per-piece members
+	auto record_placements_(std::span<board_bitmask_t const, 9> placed) noexcept -> void;
+
+	// Where each of the placed_pieces is on the board at the moment
+	[[nodiscard]] auto current_placements_() const noexcept -> placement_masks_t
+	{
+		placement_masks_t rv;
+		for (unsigned i = 0; i < placed_pieces.size(); i++)
+			rv[i] = this->*piece_member_[static_cast<unsigned>(placed_pieces[i])];
+		return rv;
+	}
+
+	// Which piece got placed on each square, in the same order as the
+	// bits of a board_bitmask_t
+	[[nodiscard]] auto piece_map_() const noexcept -> std::array<piece_id, 36>;
 
 #ifdef NDEBUG
 	auto assert_consistent_() const noexcept -> void
@@ -603,47 +1523,248 @@ class board {
 #endif // NDEBUG
 };
 
-// Object which holds the elements from a "shape" array, but with the elements
-// that conflict with the 'blockers' removed
-template<unsigned MAX_SIZE>
-class filtered_shape {
-    public:
-	filtered_shape(std::span<board_bitmask_t const> shape, board_bitmask_t blockers) noexcept
-		: count_(0)
-	{
-		for (auto const e : shape)
-			if ((e & blockers) == 0)
-				arr_[count_++] = e;
-		assert(count_ <= arr_.size());
-	}
-
-	[[nodiscard]] auto elements() const noexcept -> std::span<board_bitmask_t const>
-	{
-		return std::span<board_bitmask_t const>(arr_.cbegin(), count_);
-	}
-    private:
-	std::array<board_bitmask_t, MAX_SIZE> arr_;
-	unsigned count_;
+// How many pieces of each size are still waiting to be placed
+struct piece_tally {
+	unsigned ones;
+	unsigned twos;
+	unsigned threes;
+	unsigned fours;
 };
 
-// For each shape, make an on-stack array that only includes
-// the shapes that don't conflict with the blockers.  i.e.
-// remove all of the shapes that will never fit on this board,
-// event by themselves.
-#define MAKE_FILTERED_SHAPE(shape, blockers)	\
-	filtered_shape<std::size(shape)> const filtered_##shape(shape, blockers)
+// What is left after each level of the SOLVE_BOARD loop nest has placed
+// its piece.  The single square is never placed, so it's always left over.
+static constexpr piece_tally remaining_after_line4 = { 1, 1, 2, 4 };
+static constexpr piece_tally remaining_after_square2_2 = { 1, 1, 2, 3 };
+static constexpr piece_tally remaining_after_lblock3 = { 1, 1, 2, 2 };
+static constexpr piece_tally remaining_after_zblock = { 1, 1, 2, 1 };
+static constexpr piece_tally remaining_after_tblock = { 1, 1, 2, 0 };
+static constexpr piece_tally remaining_after_line3 = { 1, 1, 1, 0 };
+static constexpr piece_tally remaining_after_lblock2 = { 1, 1, 0, 0 };
 
-#define SHAPE_LOOP_START(shape)						\
-	for (auto const t_##shape : filtered_##shape.elements()) {	\
-		if ((t_##shape & used) == 0) {				\
-			this->shape##_ = t_##shape;			\
-			used += t_##shape
+// Board squares in the first and last columns
+static constexpr board_bitmask_t first_column = sbit(0, 0) | sbit(1, 0) | sbit(2, 0) | sbit(3, 0) | sbit(4, 0) | sbit(5, 0);
+static constexpr board_bitmask_t last_column = first_column << 5;
 
-#define SHAPE_LOOP_END(shape)						\
-			used -= t_##shape;				\
-		}							\
-	}								\
-	do { } while (0)
+// All of the squares that are next to a square in 'squares'
+[[nodiscard]] static auto constexpr neighbors_of(board_bitmask_t squares) noexcept -> board_bitmask_t
+{
+	return (((squares << 1) & ~first_column) | ((squares >> 1) & ~last_column) |
+		(squares << 6) | (squares >> 6)) & all_squares;
+}
+
+// Grow 'region' to cover every square of 'open' that it's connected to
+[[nodiscard]] static auto constexpr flood_fill(board_bitmask_t region, board_bitmask_t open) noexcept -> board_bitmask_t
+{
+	for (;;) {
+		auto const grown = (region | neighbors_of(region)) & open;
+		if (grown == region)
+			return region;
+		region = grown;
+	}
+}
+
+// Can the list of region sizes be split up exactly between the pieces in
+// 'left'?  This only looks at the number of squares, not the shapes, so a
+// "yes" doesn't guarantee anything but a "no" means the board is a dead end.
+[[nodiscard]] static auto constexpr region_sizes_fit(std::span<unsigned const> sizes, piece_tally left) noexcept -> bool
+{
+	if (sizes.empty())
+		return true;
+	auto const size = sizes.front();
+	for (unsigned fours = 0; fours <= left.fours and fours * 4 <= size; fours++) {
+		for (unsigned threes = 0; threes <= left.threes and fours * 4 + threes * 3 <= size; threes++) {
+			auto const rest = size - fours * 4 - threes * 3;
+			for (unsigned twos = 0; twos <= left.twos and twos * 2 <= rest; twos++) {
+				auto const ones = rest - twos * 2;
+				if (ones <= left.ones and
+				    region_sizes_fit(sizes.subspan(1), { left.ones - ones, left.twos - twos, left.threes - threes, left.fours - fours }))
+					return true;
+			}
+		}
+	}
+	return false;
+}
+
+// Dead-region pruning: split the empty squares of the board into connected
+// regions and check whether the pieces in 'left' could possibly fill them.
+// For instance, two isolated empty squares can never both be filled since
+// there is only one single-square piece.
+//
+// Empty squares with no empty neighbors are by far the most common way a
+// board goes bad, and we can spot those with a handful of bit operations.
+// The full flood fill costs a lot more than that, and it only pays for
+// itself near the top of the search where it can cut off a big subtree,
+// so it's only done if FLOOD_FILL is set.
+template<bool FLOOD_FILL>
+[[nodiscard]] static auto open_regions_can_be_filled(board_bitmask_t used, piece_tally left) noexcept -> bool
+{
+	auto open = all_squares & ~used;
+
+	auto const isolated = open & ~neighbors_of(open);
+	if (static_cast<unsigned>(std::popcount(isolated)) > left.ones)
+		return false;
+	if constexpr (not FLOOD_FILL)
+		return true;
+
+	std::array<unsigned, 36> sizes;
+	unsigned num_regions = 0;
+	while (open != 0) {
+		auto const region = flood_fill(open & -open, open);
+		open &= ~region;
+		sizes[num_regions++] = static_cast<unsigned>(std::popcount(region));
+	}
+	// A single region is always the right size, since the pieces
+	// left over exactly match the number of empty squares
+	return num_regions == 1 or region_sizes_fit(std::span<unsigned const>(sizes.data(), num_regions), left);
+}
+
+// Copy the elements of 'from' that don't overlap 'used' to 'to' (which has
+// room for all of them), keeping them in order, and return how many there
+// were.  'to' can be the same as 'from', to narrow a list down in place.
+//
+// Whether any one placement fits is very unpredictable, so none of these
+// branch on it: the scalar version always copies an element and then only
+// moves past it if it fits, and the others test a whole vector of them at
+// once and then compress the ones that fit together.
+[[nodiscard]] static auto filter_placements_scalar(std::span<board_bitmask_t const> from, board_bitmask_t used, board_bitmask_t *to) noexcept -> unsigned
+{
+	unsigned n = 0;
+	for (auto const e : from) {
+		to[n] = e;
+		n += ((e & used) == 0) ? 1 : 0;
+	}
+	return n;
+}
+
+#if defined(__x86_64__)
+[[gnu::target("avx512f")]] [[nodiscard]] static auto filter_placements_avx512(std::span<board_bitmask_t const> from, board_bitmask_t used, board_bitmask_t *to) noexcept -> unsigned
+{
+	auto const u = _mm512_set1_epi64(static_cast<long long>(used));
+	unsigned n = 0;
+	for (std::size_t i = 0; i < from.size(); i += 8) {
+		// The last vector may run off the end of 'from', so
+		// only load the lanes that don't
+		auto const left = from.size() - i;
+		__mmask8 const lanes = (left >= 8) ? 0xFF : static_cast<__mmask8>((1u << left) - 1);
+		auto const v = _mm512_maskz_loadu_epi64(lanes, &from[i]);
+		auto const fits = _mm512_mask_testn_epi64_mask(lanes, v, u);
+		_mm512_mask_compressstoreu_epi64(&to[n], fits, v);
+		n += static_cast<unsigned>(std::popcount(static_cast<unsigned>(fits)));
+	}
+	return n;
+}
+
+// AVX2 has no compress instruction, so this looks up a shuffle that moves
+// the lanes that fit to the front, and then stores all four.  The ones
+// past the end of what fits will get overwritten, or are past the end of
+// the list.
+alignas(32) static constexpr auto avx2_compress_shuffles = [] {
+	std::array<std::array<std::uint32_t, 8>, 16> shuffles = {};
+	for (unsigned fits = 0; fits < 16; fits++) {
+		unsigned n = 0;
+		for (unsigned lane = 0; lane < 4; lane++)
+			if ((fits & (1u << lane)) != 0) {
+				shuffles[fits][2 * n] = 2 * lane;
+				shuffles[fits][2 * n + 1] = 2 * lane + 1;
+				n++;
+			}
+	}
+	return shuffles;
+}();
+
+[[gnu::target("avx2")]] [[nodiscard]] static auto filter_placements_avx2(std::span<board_bitmask_t const> from, board_bitmask_t used, board_bitmask_t *to) noexcept -> unsigned
+{
+	auto const u = _mm256_set1_epi64x(static_cast<long long>(used));
+	unsigned n = 0;
+	std::size_t i = 0;
+	for (; i + 4 <= from.size(); i += 4) {
+		auto const v = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(&from[i]));
+		auto const overlaps = _mm256_cmpeq_epi64(_mm256_and_si256(v, u), _mm256_setzero_si256());
+		auto const fits = static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(overlaps)));
+		auto const shuffle = _mm256_load_si256(reinterpret_cast<__m256i const *>(avx2_compress_shuffles[fits].data()));
+		// Since no more than 'i' elements have been kept so far, this
+		// never writes past the end of the four just read
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(&to[n]), _mm256_permutevar8x32_epi32(v, shuffle));
+		n += static_cast<unsigned>(std::popcount(fits));
+	}
+	return n + filter_placements_scalar(from.subspan(i), used, &to[n]);
+}
+#endif
+
+using filter_placements_fn = unsigned (*)(std::span<board_bitmask_t const>, board_bitmask_t, board_bitmask_t *) noexcept;
+
+// Use the widest version the CPU can run
+[[nodiscard]] static auto pick_filter_placements() noexcept -> filter_placements_fn
+{
+#if defined(__x86_64__)
+	// This runs before main(), possibly before the compiler's own
+	// startup code has looked at the CPU
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return filter_placements_avx512;
+	if (__builtin_cpu_supports("avx2"))
+		return filter_placements_avx2;
+#endif
+	return filter_placements_scalar;
+}
+
+static filter_placements_fn const filter_placements = pick_filter_placements();
+
+// Object which holds the elements from a "shape" array, but with the elements
+// that conflict with the 'blockers' removed
+template<unsigned MAX_SIZE>
+class filtered_shape {
+    public:
+	filtered_shape(std::span<board_bitmask_t const> shape, board_bitmask_t blockers) noexcept
+		: count_(0)
+	{
+		assert(shape.size() <= arr_.size());
+		count_ = filter_placements(shape, blockers, arr_.data());
+	}
+
+	[[nodiscard]] auto elements() const noexcept -> std::span<board_bitmask_t const>
+	{
+		return std::span<board_bitmask_t const>(arr_.cbegin(), count_);
+	}
+    private:
+	std::array<board_bitmask_t, MAX_SIZE> arr_;
+	unsigned count_;
+};
+
+// For each shape, make an on-stack array that only includes
+// the shapes that don't conflict with the blockers.  i.e.
+// remove all of the shapes that will never fit on this board,
+// event by themselves.
+#define MAKE_FILTERED_SHAPE(shape, blockers)	\
+	filtered_shape<std::size(shape)> const filtered_##shape(shape, blockers)
+
+// How many pieces are on the board once the loop nest has placed 'piece'
+[[nodiscard]] static auto consteval loop_nest_depth(piece_id piece) noexcept -> unsigned
+{
+	for (unsigned i = 0; i < placed_pieces.size(); i++)
+		if (placed_pieces[i] == piece)
+			return i + 1;
+	abort();
+}
+
+// Each placement is followed by a check that the board isn't already a
+// dead end (see open_regions_can_be_filled())
+#define SHAPE_LOOP_START(shape)						\
+	for (auto const t_##shape : filtered_##shape.elements()) {	\
+		stats.tested(piece_id::shape);				\
+		if ((t_##shape & used) != 0)				\
+			continue;					\
+		stats.passed(piece_id::shape);				\
+		if (open_regions_can_be_filled<false>(used | t_##shape, remaining_after_##shape)) { \
+			this->shape##_ = t_##shape;			\
+			stats.placed(piece_id::shape, loop_nest_depth(piece_id::shape)); \
+			used += t_##shape
+
+#define SHAPE_LOOP_END(shape)						\
+			used -= t_##shape;				\
+		}							\
+	}								\
+	do { } while (0)
 
 // Common code between solve() and count_solutions()  This big macro is
 // ugly but it allows us to efficiently early-return in the former case.
@@ -665,7 +1786,12 @@ do {										\
 	MAKE_FILTERED_SHAPE(line2, used);					\
 										\
 	for (auto const t_line4 : filtered_line4.elements()) {			\
+		stats.tested(piece_id::line4);					\
+		stats.passed(piece_id::line4);					\
+		if (not open_regions_can_be_filled<true>(used | t_line4, remaining_after_line4)) \
+			continue;						\
 		this->line4_ = t_line4;						\
+		stats.placed(piece_id::line4, loop_nest_depth(piece_id::line4)); \
 		used += t_line4;						\
 										\
 		SHAPE_LOOP_START(square2_2);					\
@@ -676,8 +1802,12 @@ do {										\
 		SHAPE_LOOP_START(lblock2);					\
 										\
 		for (auto const t_line2 : filtered_line2.elements()) {		\
+			stats.tested(piece_id::line2);				\
 			if ((t_line2 & used) == 0) {				\
+				stats.passed(piece_id::line2);			\
 				this->line2_ = t_line2;				\
+				stats.placed(piece_id::line2, loop_nest_depth(piece_id::line2)); \
+				stats.solved();					\
 				assert_consistent_();				\
 				solved_action;					\
 			}							\
@@ -694,216 +1824,3551 @@ do {										\
 	}									\
 } while (0)
 
-auto board::solve() noexcept -> bool
+template<typename STATS>
+auto board::solve_loop_nest_(STATS& stats) noexcept -> bool
 {
 	SOLVE_BOARD(return true);
 	[[unlikely]] return false;
 }
 
-auto board::count_solutions() noexcept -> unsigned
+template<typename STATS>
+auto board::count_solutions_loop_nest_(STATS& stats) noexcept -> unsigned
 {
 	unsigned count = 0;
 	SOLVE_BOARD(count++);
 	return count;
 }
 
-#undef MAKE_FILTERED_SHAPE
-#undef SHAPE_LOOP_START
-#undef SHAPE_LOOP_END
-#undef SOLVE_BOARD
+// The last three pieces that the loop nest places, in one of the ways they
+// can finish off a board
+struct last_pieces {
+	board_bitmask_t line3;
+	board_bitmask_t lblock2;
+	board_bitmask_t line2;
+};
 
-#ifndef NDEBUG
-auto board::assert_consistent_() const noexcept -> void
+// The most ways there can be to finish off a board with the last three
+// pieces.  That leaves nine empty squares.  line3 can only start at one of
+// them and go one of two ways.  lblock2 can only have its corner on one of
+// the six left after that, facing one of four ways.  At most two pairs of
+// the last three squares are next to each other, so there are at most two
+// places for line2.
+static constexpr unsigned max_last_pieces = (9 * 2) * (6 * 4) * 2;
+
+// Every way to finish off the board by placing the last three pieces, in
+// the order the loop nest would find them.  Returns how many there were.
+template<typename LINE3, typename LBLOCK2, typename LINE2>
+[[nodiscard]] static inline auto find_last_pieces(LINE3 const& filtered_line3, LBLOCK2 const& filtered_lblock2, LINE2 const& filtered_line2,
+						  board_bitmask_t used, last_pieces *out) noexcept -> unsigned
 {
-	auto const all_bits = this->blockers_ | this->line4_ | this->square2_2_ | this->lblock3_ | this->zblock_ | this->tblock_ | this->line3_ | this->lblock2_ | this->line2_;
-	// Cheap check to make sure no blocks got placed on top each other:
-	assert(all_bits ==
-	  (this->blockers_ + this->line4_ + this->square2_2_ + this->lblock3_ + this->zblock_ + this->tblock_ + this->line3_ + this->lblock2_ + this->line2_));
-	// Verify that there is exactly one unplaced spot (i.e.
-	// where the single square will go)
-	auto const unused_bits = 0xF'FFFF'FFFFull ^ all_bits;
-	assert(unused_bits != 0);
-	assert((unused_bits & (unused_bits - 1)) == 0);
+	unsigned n = 0;
+	for (auto const t_line3 : filtered_line3.elements()) {
+		if ((t_line3 & used) != 0 or not open_regions_can_be_filled<false>(used | t_line3, remaining_after_line3))
+			continue;
+		for (auto const t_lblock2 : filtered_lblock2.elements()) {
+			if ((t_lblock2 & (used | t_line3)) != 0 or not open_regions_can_be_filled<false>(used | t_line3 | t_lblock2, remaining_after_lblock2))
+				continue;
+			for (auto const t_line2 : filtered_line2.elements()) {
+				if ((t_line2 & (used | t_line3 | t_lblock2)) == 0) {
+					assert(n < max_last_pieces);
+					out[n++] = { t_line3, t_lblock2, t_line2 };
+				}
+			}
+		}
+	}
+	return n;
 }
-#endif // !NDEBUG
 
-auto board::piece_at(unsigned row, unsigned col) const noexcept -> piece_id
+// This is SOLVE_BOARD, but as a coroutine.  Anything that a coroutine keeps
+// from one "co_yield" to the next lives in memory rather than registers,
+// which slows down the innermost loops, where the search spends most of its
+// time.  So those don't get run as part of the coroutine: for each way of
+// placing the first five pieces it finds all of the ways to place the last
+// three in one go, and then yields them one at a time.
+auto board::solutions() noexcept -> generator<placement_masks_t>
 {
-	auto const p = sbit(row, col);
+	no_search_stats stats;
+	board_bitmask_t used = this->blockers_;
 
-#define SHAPE_CHECK(shape)			\
-	if ((p & this->shape##_) != 0)		\
-		return piece_id::shape;		\
-	do { } while (0)
+	MAKE_FILTERED_SHAPE(line4, used);
+	MAKE_FILTERED_SHAPE(square2_2, used);
+	MAKE_FILTERED_SHAPE(lblock3, used);
+	MAKE_FILTERED_SHAPE(zblock, used);
+	MAKE_FILTERED_SHAPE(tblock, used);
+	MAKE_FILTERED_SHAPE(line3, used);
+	MAKE_FILTERED_SHAPE(lblock2, used);
+	MAKE_FILTERED_SHAPE(line2, used);
+	std::array<last_pieces, max_last_pieces> finishes;
 
-	SHAPE_CHECK(blockers);
-	SHAPE_CHECK(line4);
-	SHAPE_CHECK(square2_2);
-	SHAPE_CHECK(lblock3);
-	SHAPE_CHECK(zblock);
-	SHAPE_CHECK(tblock);
-	SHAPE_CHECK(line3);
-	SHAPE_CHECK(lblock2);
-	SHAPE_CHECK(line2);
-#undef SHAPE_CHECK
+	for (auto const t_line4 : filtered_line4.elements()) {
+		if (not open_regions_can_be_filled<true>(used | t_line4, remaining_after_line4))
+			continue;
+		this->line4_ = t_line4;
+		used += t_line4;
 
-	return piece_id::single_block;
-}
+		SHAPE_LOOP_START(square2_2);
+		SHAPE_LOOP_START(lblock3);
+		SHAPE_LOOP_START(zblock);
+		SHAPE_LOOP_START(tblock);
 
-auto board::print() const noexcept -> void
-{
-	for (unsigned row = 0; row < 6; row++) {
-		for (unsigned col = 0; col < 6; col++) {
-			auto const p = static_cast<unsigned>(piece_at(row, col));
-			assert(p < piece_rendering.size());
-			fputs(piece_rendering[p], stdout);
+		auto const num_finishes = find_last_pieces(filtered_line3, filtered_lblock2, filtered_line2, used, finishes.data());
+		for (unsigned i = 0; i < num_finishes; i++) {
+			this->line3_ = finishes[i].line3;
+			this->lblock2_ = finishes[i].lblock2;
+			this->line2_ = finishes[i].line2;
+			assert_consistent_();
+			co_yield current_placements_();
 		}
-		putchar('\n');
+
+		SHAPE_LOOP_END(tblock);
+		SHAPE_LOOP_END(zblock);
+		SHAPE_LOOP_END(lblock3);
+		SHAPE_LOOP_END(square2_2);
+
+		used -= t_line4;
 	}
 }
 
-[[nodiscard]] static auto verify_roll(board_bitmask_t blockers) noexcept -> bool
-{
-	assert(blockers_are_valid_roll(blockers));
-	board b(blockers);
-	if (not b.solve()) {
-		[[unlikely]] fprintf(stderr, "Error: Couldn't solve board %09llX\n", blockers);
-		return false;
+#undef MAKE_FILTERED_SHAPE
+#undef SHAPE_LOOP_START
+#undef SHAPE_LOOP_END
+#undef SOLVE_BOARD
+
+// The narrowing engine ("--engine narrowing") places the pieces in the same
+// order as the loop nest, and tries their placements in the same order too,
+// so it finds the same solutions.  The difference is that the loop nest
+// only throws away the placements that overlap the blockers up front, and
+// then every level tests each of its placements against what's been placed
+// since.  Deep in the search most of those tests fail.  Instead, every time
+// this places a piece it narrows down the lists of all of the pieces still
+// to come, keeping only what still fits.  So each level only ever looks at
+// placements that fit, and as soon as any of the later pieces has nowhere
+// left to go it knows this is a dead end, rather than finding out when it
+// gets down to that piece.
+
+// What's left of the lists for each of placed_pieces, at one level of the
+// narrowing search.  Each level only uses the lists of the pieces it and
+// the levels below it place, and narrows them into the next level's.
+static constexpr auto narrowing_list_offsets = [] {
+	std::array<unsigned, placed_pieces.size() + 1> offsets = {};
+	for (unsigned level = 0; level < placed_pieces.size(); level++)
+		offsets[level + 1] = offsets[level] + static_cast<unsigned>(placements_of_piece[static_cast<unsigned>(placed_pieces[level])].size());
+	return offsets;
+}();
+
+struct narrowing_lists {
+	std::array<board_bitmask_t, narrowing_list_offsets.back()> placements;
+	std::array<unsigned, placed_pieces.size()> lengths;
+
+	[[nodiscard]] auto list(unsigned level) const noexcept -> std::span<board_bitmask_t const>
+	{
+		return std::span<board_bitmask_t const>(&placements[narrowing_list_offsets[level]], lengths[level]);
 	}
-	return true;
-}
+};
 
-[[nodiscard]] static auto verify_all_possible_rolls() noexcept -> bool
-{
-	// Iterate through all combinations of *unique* faces on each
-	// die.  Since some dice have the same value on multiple faces
-	// this reduces the search space a lot:
-	bool ok = true;
-	for (auto const d0 : unique_faces_0)
-		for (auto const d1 : unique_faces_1)
-			for (auto const d2 : unique_faces_2)
-				for (auto const d3 : unique_faces_3)
-					for (auto const d4 : unique_faces_4)
-						for (auto const d5 : unique_faces_5)
-							for (auto const d6 : unique_faces_6)
-								if (not verify_roll(d0 | d1 | d2 | d3 | d4 | d5 | d6))
-									[[unlikely]] ok = false;
-	return ok;
-}
+// remaining_after_line4 and so on, by level
+static constexpr std::array<piece_tally, placed_pieces.size() - 1> remaining_after_level = {
+	remaining_after_line4,
+	remaining_after_square2_2,
+	remaining_after_lblock3,
+	remaining_after_zblock,
+	remaining_after_tblock,
+	remaining_after_line3,
+	remaining_after_lblock2,
+};
 
-static auto show_solution_count_for(board_bitmask_t blockers) noexcept -> void
+template<unsigned LEVEL, typename STATS, typename F>
+auto board::narrow_(narrowing_lists *lists, board_bitmask_t used, STATS& stats, F const& on_solved) noexcept -> bool
 {
-	assert(blockers_are_valid_roll(blockers));
-	board b(blockers);
-	printf("%u\t", b.count_solutions());
-	char const *before = "";
-	for (unsigned row = 0; row < 6; row++) {
-		for (unsigned col = 0; col < 6; col++) {
-			if ((sbit(row, col) & blockers) != 0) {
-				printf("%s%c%u", before, 'A' + row, col + 1);
-				before = " ";
+	static constexpr auto piece = placed_pieces[LEVEL];
+	for (auto const t : lists->list(LEVEL)) {
+		stats.tested(piece);
+		stats.passed(piece);
+		if constexpr (LEVEL + 1 == placed_pieces.size()) {
+			this->*piece_member_[static_cast<unsigned>(piece)] = t;
+			stats.placed(piece, LEVEL + 1);
+			stats.solved();
+			assert_consistent_();
+			if (on_solved())
+				return true;
+		} else {
+			// Like the loop nest, the first level also does
+			// the full check for regions that can't be filled
+			if (not open_regions_can_be_filled<LEVEL == 0>(used | t, remaining_after_level[LEVEL]))
+				continue;
+			this->*piece_member_[static_cast<unsigned>(piece)] = t;
+			stats.placed(piece, LEVEL + 1);
+			auto const next = lists + 1;
+			bool dead_end = false;
+			for (unsigned level = LEVEL + 1; level < placed_pieces.size(); level++) {
+				next->lengths[level] = filter_placements(lists->list(level), t, &next->placements[narrowing_list_offsets[level]]);
+				if (next->lengths[level] == 0) {
+					dead_end = true;
+					break;
+				}
 			}
+			if (not dead_end and narrow_<LEVEL + 1>(next, used | t, stats, on_solved))
+				return true;
 		}
 	}
-	putchar('\n');
+	return false;
 }
 
-static auto count_solutions_of_every_board_position() noexcept -> void
+// Start off the narrowing search with each piece's placements that don't
+// overlap the blockers.  The lists for every level go on the stack.
+template<typename STATS, typename F>
+auto board::narrowing_search_(STATS& stats, F const& on_solved) noexcept -> bool
 {
-	for (auto const d0 : unique_faces_0)
-		for (auto const d1 : unique_faces_1)
-			for (auto const d2 : unique_faces_2)
-				for (auto const d3 : unique_faces_3)
-					for (auto const d4 : unique_faces_4)
-						for (auto const d5 : unique_faces_5)
-							for (auto const d6 : unique_faces_6)
-								show_solution_count_for(d0 | d1 | d2 | d3 | d4 | d5 | d6);
+	std::array<narrowing_lists, placed_pieces.size()> lists;
+	for (unsigned level = 0; level < placed_pieces.size(); level++) {
+		auto const placements = placements_of_piece[static_cast<unsigned>(placed_pieces[level])];
+		lists[0].lengths[level] = filter_placements(placements, blockers_, &lists[0].placements[narrowing_list_offsets[level]]);
+		if (lists[0].lengths[level] == 0)
+			return false;
+	}
+	return narrow_<0>(lists.data(), blockers_, stats, on_solved);
 }
 
-static auto usage(FILE *fp) noexcept -> void
-{
-	fputs(	"Usage:\n"
-		"\t"	"gsqsolve <die_1> <die_2> ... <die_7>\n"
-		"\t"	"sqsolve --random [count]\n"
-		"\t"	"gsqsolve --verify-all\n"
-		"\t"	"gsqsolve --solution-counts\n", fp);
-}
+// The SIMD engine ("--engine simd") runs the same search as the loop nest,
+// but on lots of boards at once.  Each lane of a vector register works on
+// a different board, with its own copy of the loop nest's state: how many
+// pieces are down, which placement of the next piece it's up to, and the
+// "used" mask.  Each step tests every lane's next placement against its
+// own used mask (and does the same check for isolated squares that
+// SHAPE_LOOP_START() does), and then each lane either places it, moves
+// on to the next placement, or backs up a level.  That's all done with
+// masked vector operations, so the lanes don't have to wait for each
+// other.  When a lane solves its board, or runs out of placements for the
+// first piece, it gets handed the next board.  Since each lane goes
+// through the placements in the same order, it finds the same solution
+// the loop nest would have.
+//
+// Each step has to wait for the gather in the one before it, so there are
+// two sets of lanes whose steps are interleaved to keep the CPU busy.
+//
+// board::solve() with this engine just uses the loop nest, since there is
+// only one board.  The SIMD engine only comes into play when there are
+// lots of boards to solve (see solve_boards()), and only on an x86 CPU
+// with AVX2 or AVX-512.  It can't count solutions or collect statistics.
+#if defined(__x86_64__)
 
-} // anonymous namespace
+// Each lane keeps its own copy of the placements of each piece that don't
+// overlap its board's blockers, with each level of the loop nest starting
+// at a fixed offset.  That way a lane's position within a level fits in a
+// byte, and so does the length of each level's list.  Those get packed
+// into one 64-bit value per lane, a byte for each level.
+static constexpr unsigned max_placements_per_piece = 160;
+static_assert(max_placements_per_piece <= 0xFF);
+static_assert(std::ranges::all_of(placements_of_piece, [](auto const placements) {
+	return placements.size() <= max_placements_per_piece;
+}));
 
-auto main(int argn, char const * const *argv) noexcept -> int
-{
-	if (argn == 2) {
-		auto const arg = argv[1];
-		if (0 == strcmp(arg, "--help")) {
-			usage(stdout);
-			return EX_OK;
+struct lockstep_lane {
+	std::array<board_bitmask_t, placed_pieces.size() * max_placements_per_piece> placements;
+};
+static constexpr unsigned lockstep_lane_stride = sizeof(lockstep_lane) / sizeof(board_bitmask_t);
+
+// Where each lane's placements start, relative to the first lane
+alignas(64) static constexpr std::array<board_bitmask_t, 8> lockstep_lane_offsets = {
+	0, lockstep_lane_stride, 2 * lockstep_lane_stride, 3 * lockstep_lane_stride,
+	4 * lockstep_lane_stride, 5 * lockstep_lane_stride, 6 * lockstep_lane_stride, 7 * lockstep_lane_stride,
+};
+
+// The vector operations that LOCKSTEP_RUN() needs, for each instruction
+// set.  A "mask" says which lanes something applies to.
+#define LOCKSTEP_AVX512 gnu::target("avx512f"), gnu::always_inline
+struct avx512_lanes {
+	static constexpr unsigned width = 8;
+	using vec = __m512i;
+	using mask = __mmask8;
+	// GCC 12's versions of some of the unmasked intrinsics trip
+	// -Wmaybe-uninitialized, so those use the masked ones with every
+	// lane turned on instead
+	static constexpr mask all_lanes = 0xFF;
+
+	[[LOCKSTEP_AVX512]] static inline auto load(board_bitmask_t const *p) noexcept -> vec { return _mm512_load_si512(p); }
+	[[LOCKSTEP_AVX512]] static inline auto store(board_bitmask_t *p, vec v) noexcept -> void { _mm512_store_si512(p, v); }
+	[[LOCKSTEP_AVX512]] static inline auto splat(board_bitmask_t x) noexcept -> vec { return _mm512_set1_epi64(static_cast<long long>(x)); }
+	[[LOCKSTEP_AVX512]] static inline auto zero() noexcept -> vec { return _mm512_setzero_si512(); }
+	[[LOCKSTEP_AVX512]] static inline auto bit_and(vec a, vec b) noexcept -> vec { return _mm512_and_si512(a, b); }
+	[[LOCKSTEP_AVX512]] static inline auto bit_or(vec a, vec b) noexcept -> vec { return _mm512_or_si512(a, b); }
+	[[LOCKSTEP_AVX512]] static inline auto bit_xor(vec a, vec b) noexcept -> vec { return _mm512_xor_si512(a, b); }
+	// ~a & b
+	[[LOCKSTEP_AVX512]] static inline auto bit_andnot(vec a, vec b) noexcept -> vec { return _mm512_maskz_andnot_epi64(all_lanes, a, b); }
+	[[LOCKSTEP_AVX512]] static inline auto add(vec a, vec b) noexcept -> vec { return _mm512_add_epi64(a, b); }
+	[[LOCKSTEP_AVX512]] static inline auto sub(vec a, vec b) noexcept -> vec { return _mm512_sub_epi64(a, b); }
+	// Only for numbers that fit in 32 bits
+	[[LOCKSTEP_AVX512]] static inline auto mul(vec a, vec b) noexcept -> vec { return _mm512_maskz_mul_epu32(all_lanes, a, b); }
+	template<unsigned N>
+	[[LOCKSTEP_AVX512]] static inline auto shift_left(vec a) noexcept -> vec { return _mm512_maskz_slli_epi64(all_lanes, a, N); }
+	template<unsigned N>
+	[[LOCKSTEP_AVX512]] static inline auto shift_right(vec a) noexcept -> vec { return _mm512_maskz_srli_epi64(all_lanes, a, N); }
+	[[LOCKSTEP_AVX512]] static inline auto shift_left(vec a, vec n) noexcept -> vec { return _mm512_maskz_sllv_epi64(all_lanes, a, n); }
+	[[LOCKSTEP_AVX512]] static inline auto shift_right(vec a, vec n) noexcept -> vec { return _mm512_maskz_srlv_epi64(all_lanes, a, n); }
+	// m ? a : b
+	[[LOCKSTEP_AVX512]] static inline auto select(mask m, vec a, vec b) noexcept -> vec { return _mm512_mask_blend_epi64(m, b, a); }
+	// m ? base[idx] : 0
+	[[LOCKSTEP_AVX512]] static inline auto gather(mask m, board_bitmask_t const *base, vec idx) noexcept -> vec
+	{
+		return _mm512_mask_i64gather_epi64(_mm512_setzero_si512(), m, idx, base, sizeof(board_bitmask_t));
+	}
+	// Lanes of 'm' where a & b is 0
+	[[LOCKSTEP_AVX512]] static inline auto no_overlap(mask m, vec a, vec b) noexcept -> mask { return _mm512_mask_testn_epi64_mask(m, a, b); }
+	[[LOCKSTEP_AVX512]] static inline auto less(vec a, vec b) noexcept -> mask { return _mm512_cmplt_epu64_mask(a, b); }
+	[[LOCKSTEP_AVX512]] static inline auto equal(vec a, vec b) noexcept -> mask { return _mm512_cmpeq_epu64_mask(a, b); }
+	[[LOCKSTEP_AVX512]] static inline auto mask_and(mask a, mask b) noexcept -> mask { return a & b; }
+	[[LOCKSTEP_AVX512]] static inline auto mask_or(mask a, mask b) noexcept -> mask { return a | b; }
+	// a & ~b
+	[[LOCKSTEP_AVX512]] static inline auto mask_andnot(mask a, mask b) noexcept -> mask { return a & static_cast<mask>(~b); }
+	[[LOCKSTEP_AVX512]] static inline auto mask_bits(mask m) noexcept -> unsigned { return m; }
+	[[LOCKSTEP_AVX512]] static inline auto mask_of_bits(unsigned bits) noexcept -> mask { return static_cast<mask>(bits); }
+};
+#undef LOCKSTEP_AVX512
+
+#define LOCKSTEP_AVX2 gnu::target("avx2"), gnu::always_inline
+struct avx2_lanes {
+	static constexpr unsigned width = 4;
+	using vec = __m256i;
+	// All ones in each lane that's included
+	using mask = __m256i;
+
+	[[LOCKSTEP_AVX2]] static inline auto load(board_bitmask_t const *p) noexcept -> vec { return _mm256_load_si256(reinterpret_cast<__m256i const *>(p)); }
+	[[LOCKSTEP_AVX2]] static inline auto store(board_bitmask_t *p, vec v) noexcept -> void { _mm256_store_si256(reinterpret_cast<__m256i *>(p), v); }
+	[[LOCKSTEP_AVX2]] static inline auto splat(board_bitmask_t x) noexcept -> vec { return _mm256_set1_epi64x(static_cast<long long>(x)); }
+	[[LOCKSTEP_AVX2]] static inline auto zero() noexcept -> vec { return _mm256_setzero_si256(); }
+	[[LOCKSTEP_AVX2]] static inline auto bit_and(vec a, vec b) noexcept -> vec { return _mm256_and_si256(a, b); }
+	[[LOCKSTEP_AVX2]] static inline auto bit_or(vec a, vec b) noexcept -> vec { return _mm256_or_si256(a, b); }
+	[[LOCKSTEP_AVX2]] static inline auto bit_xor(vec a, vec b) noexcept -> vec { return _mm256_xor_si256(a, b); }
+	[[LOCKSTEP_AVX2]] static inline auto bit_andnot(vec a, vec b) noexcept -> vec { return _mm256_andnot_si256(a, b); }
+	[[LOCKSTEP_AVX2]] static inline auto add(vec a, vec b) noexcept -> vec { return _mm256_add_epi64(a, b); }
+	[[LOCKSTEP_AVX2]] static inline auto sub(vec a, vec b) noexcept -> vec { return _mm256_sub_epi64(a, b); }
+	[[LOCKSTEP_AVX2]] static inline auto mul(vec a, vec b) noexcept -> vec { return _mm256_mul_epu32(a, b); }
+	template<unsigned N>
+	[[LOCKSTEP_AVX2]] static inline auto shift_left(vec a) noexcept -> vec { return _mm256_slli_epi64(a, N); }
+	template<unsigned N>
+	[[LOCKSTEP_AVX2]] static inline auto shift_right(vec a) noexcept -> vec { return _mm256_srli_epi64(a, N); }
+	[[LOCKSTEP_AVX2]] static inline auto shift_left(vec a, vec n) noexcept -> vec { return _mm256_sllv_epi64(a, n); }
+	[[LOCKSTEP_AVX2]] static inline auto shift_right(vec a, vec n) noexcept -> vec { return _mm256_srlv_epi64(a, n); }
+	[[LOCKSTEP_AVX2]] static inline auto select(mask m, vec a, vec b) noexcept -> vec { return _mm256_blendv_epi8(b, a, m); }
+	[[LOCKSTEP_AVX2]] static inline auto gather(mask m, board_bitmask_t const *base, vec idx) noexcept -> vec
+	{
+		return _mm256_mask_i64gather_epi64(_mm256_setzero_si256(), reinterpret_cast<long long const *>(base), idx, m, sizeof(board_bitmask_t));
+	}
+	[[LOCKSTEP_AVX2]] static inline auto no_overlap(mask m, vec a, vec b) noexcept -> mask
+	{
+		return _mm256_and_si256(m, _mm256_cmpeq_epi64(_mm256_and_si256(a, b), _mm256_setzero_si256()));
+	}
+	// Everything this gets used on is small enough that a signed
+	// comparison works
+	[[LOCKSTEP_AVX2]] static inline auto less(vec a, vec b) noexcept -> mask { return _mm256_cmpgt_epi64(b, a); }
+	[[LOCKSTEP_AVX2]] static inline auto equal(vec a, vec b) noexcept -> mask { return _mm256_cmpeq_epi64(a, b); }
+	[[LOCKSTEP_AVX2]] static inline auto mask_and(mask a, mask b) noexcept -> mask { return _mm256_and_si256(a, b); }
+	[[LOCKSTEP_AVX2]] static inline auto mask_or(mask a, mask b) noexcept -> mask { return _mm256_or_si256(a, b); }
+	[[LOCKSTEP_AVX2]] static inline auto mask_andnot(mask a, mask b) noexcept -> mask { return _mm256_andnot_si256(b, a); }
+	[[LOCKSTEP_AVX2]] static inline auto mask_bits(mask m) noexcept -> unsigned
+	{
+		return static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(m)));
+	}
+	[[LOCKSTEP_AVX2]] static inline auto mask_of_bits(unsigned bits) noexcept -> mask
+	{
+		auto const lane_bits = _mm256_set_epi64x(8, 4, 2, 1);
+		return _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_set1_epi64x(bits), lane_bits), lane_bits);
+	}
+};
+#undef LOCKSTEP_AVX2
+
+class lockstep_solver {
+    public:
+	// Solve every one of 'boards', putting its solution (or std::nullopt)
+	// in the same position of 'solutions'.  Returns false without doing
+	// anything if the CPU doesn't have the instructions this needs.
+	[[nodiscard]] static auto solve(std::span<board_bitmask_t const> boards, std::span<std::optional<placement_indices_t>> solutions) noexcept -> bool;
+
+    private:
+	static constexpr unsigned num_levels = placed_pieces.size();
+	static constexpr unsigned num_groups = 2;
+	static constexpr unsigned max_lanes = num_groups * avx512_lanes::width;
+	static constexpr std::size_t no_board = SIZE_MAX;
+
+	lockstep_solver(std::span<board_bitmask_t const> boards, std::span<std::optional<placement_indices_t>> solutions, unsigned num_lanes) noexcept
+		: boards_(boards)
+		, solutions_(solutions)
+		, lanes_(thread_lanes_(num_lanes))
+	{
+		assert(boards.size() == solutions.size());
+		assert(num_lanes <= max_lanes);
+		for (unsigned i = 0; i < num_lanes; i++)
+			start_lane_(i);
+	}
+
+	// The lanes' placement lists are too big to go on the stack, so each
+	// thread keeps one set of them to use every time
+	[[nodiscard]] static auto thread_lanes_(unsigned num_lanes) noexcept -> std::vector<lockstep_lane>&
+	{
+		thread_local std::vector<lockstep_lane> lanes;
+		if (lanes.size() < num_lanes)
+			lanes.resize(num_lanes);
+		return lanes;
+	}
+
+	std::span<board_bitmask_t const> const boards_;
+	std::span<std::optional<placement_indices_t>> const solutions_;
+	std::vector<lockstep_lane>& lanes_;
+	std::size_t next_board_ = 0;
+	unsigned busy_lanes_ = 0;
+	// Which board each lane is solving, or no_board
+	std::array<std::size_t, max_lanes> board_of_;
+	// Each lane's search state, while it's not in a vector register:
+	// its used mask, how many pieces it has placed, its position in the
+	// current level's list, the length of each level's list (a byte
+	// each), and the position it placed each piece at (ditto)
+	alignas(64) std::array<board_bitmask_t, max_lanes> used_;
+	alignas(64) std::array<board_bitmask_t, max_lanes> level_;
+	alignas(64) std::array<board_bitmask_t, max_lanes> position_;
+	alignas(64) std::array<board_bitmask_t, max_lanes> lengths_;
+	alignas(64) std::array<board_bitmask_t, max_lanes> stack_;
+
+	// Give lane 'i' the next board to solve, if there is one
+	auto start_lane_(unsigned i) noexcept -> void
+	{
+		if (next_board_ == boards_.size()) {
+			board_of_[i] = no_board;
+			used_[i] = level_[i] = position_[i] = lengths_[i] = stack_[i] = 0;
+			return;
 		}
-		if (0 == strcmp(arg, "--verify-all"))
-			return verify_all_possible_rolls() ? EX_OK : 1;
-		if (0 == strcmp(arg, "--solution-counts")) {
-			count_solutions_of_every_board_position();
-			return EX_OK;
+		auto const blockers = boards_[next_board_];
+		board_of_[i] = next_board_++;
+		busy_lanes_++;
+
+		auto& lane = lanes_[i];
+		board_bitmask_t lengths = 0;
+		for (unsigned level = 0; level < num_levels; level++) {
+			auto const placements = placements_of_piece[static_cast<unsigned>(placed_pieces[level])];
+			auto const n = filter_placements(placements, blockers, &lane.placements[level * max_placements_per_piece]);
+			lengths |= static_cast<board_bitmask_t>(n) << (8 * level);
 		}
+		used_[i] = blockers;
+		level_[i] = position_[i] = stack_[i] = 0;
+		lengths_[i] = lengths;
 	}
-	if (argn >= 2 and argn <= 3 and 0 == strcmp(argv[1], "--random")) {
-		std::srand(static_cast<unsigned>(std::time(nullptr)));
 
-		auto const count = (argn == 2) ? 1u : static_cast<unsigned>(atoi(argv[2]));
-		if (count == 0) {
-			[[unlikely]] usage(stderr);
-			return EX_USAGE;
-		}
-		for (unsigned i = 0;;) {
-			board b(random_blockers());
-			if (not b.solve()) {
-				[[unlikely]] fputs("Error: No solution!\n", stderr);	// should be impossible!
-				return EX_SOFTWARE;
-			}
-			b.print();
-			if (++i >= count) {
-				assert(i == count);
-				break;
+	// Lane 'i' has either solved its board or found that it can't be
+	// solved, so record that and move on to the next one
+	auto finish_lane_(unsigned i, bool solved) noexcept -> void
+	{
+		assert(board_of_[i] != no_board);
+		auto& solution = solutions_[board_of_[i]];
+		if (solved) {
+			auto const& lane = lanes_[i];
+			placement_indices_t indices;
+			for (unsigned level = 0; level < num_levels; level++) {
+				// The last piece went where the lane was when it
+				// solved the board, which is one behind where it
+				// is now
+				auto const position = (level + 1 < num_levels) ? ((stack_[i] >> (8 * level)) & 0xFF) : position_[i] - 1;
+				auto const placement = lane.placements[level * max_placements_per_piece + position];
+				// That's from the lane's own copy of the list, so
+				// find where it came from in the original
+				auto const placements = placements_of_piece[static_cast<unsigned>(placed_pieces[level])];
+				indices[level] = static_cast<std::uint8_t>(std::ranges::find(placements, placement) - placements.begin());
 			}
-			putchar('\n');
+			solution = indices;
+		} else {
+			solution = std::nullopt;
 		}
-		return EX_OK;
+		busy_lanes_--;
+		start_lane_(i);
 	}
-	if (argn != 8) {
-		[[unlikely]] usage(stderr);
-		return EX_USAGE;
-	}
-	board_bitmask_t blockers = 0;
-	bool parsed_ok = true;
-	for (unsigned i = 1; i <= 7; i++) {
-		auto const arg = argv[i];
-		auto const b = sbit(arg);
-		if (b == 0) {
-			[[unlikely]] parsed_ok = false;
-			fprintf(stderr, "Error: Bad board position: \"%s\"\n", arg);
-		}
-		if ((blockers & b) != 0) {
-			[[unlikely]] parsed_ok = false;
-			fprintf(stderr, "Error: Board position listed multiple times: \"%s\"\n", arg);
+
+	// The lanes (as bits of 'candidates') that are about to place their
+	// first piece, minus any where that fails the full dead-region check
+	// that the loop nest does at that level
+	[[nodiscard]] auto flood_fill_check_(unsigned candidates, board_bitmask_t const *used) const noexcept -> unsigned
+	{
+		for (auto bits = candidates; bits != 0; bits &= bits - 1) {
+			auto const i = static_cast<unsigned>(std::countr_zero(bits));
+			if (not open_regions_can_be_filled<true>(used[i], remaining_after_line4))
+				candidates &= ~(1u << i);
 		}
-		blockers |= b;
+		return candidates;
 	}
-	if (not parsed_ok) {
-		[[unlikely]] usage(stderr);
-		return EX_USAGE;
+
+	auto run_avx512_() noexcept -> void;
+	auto run_avx2_() noexcept -> void;
+};
+
+// One step for each lane in group 'g'
+#define LOCKSTEP_STEP(LANES, g)							\
+do {										\
+	auto const base = lanes_[(g) * LANES::width].placements.data();	\
+	auto const byte_shift = LANES::shift_left<3>(level[g]);	\
+	auto const length = LANES::bit_and(LANES::shift_right(lengths[g], byte_shift), ff); \
+	auto const in_list = LANES::less(position[g], length);			\
+	auto const idx = LANES::add(offsets, LANES::add(LANES::mul(level[g], level_size), position[g])); \
+	auto const t = LANES::gather(in_list, base, idx);			\
+	auto const next_used = LANES::bit_or(used[g], t);			\
+										\
+	/* The same check for isolated squares as SHAPE_LOOP_START() */	\
+	auto const open = LANES::bit_andnot(next_used, all);			\
+	auto const neighbors = LANES::bit_and(LANES::bit_or(			\
+		LANES::bit_or(LANES::bit_and(LANES::shift_left<1>(open), not_first_column), \
+			      LANES::bit_and(LANES::shift_right<1>(open), not_last_column)), \
+		LANES::bit_or(LANES::shift_left<6>(open), LANES::shift_right<6>(open))), all); \
+	auto const isolated = LANES::bit_andnot(neighbors, open);		\
+	auto fits = LANES::no_overlap(LANES::no_overlap(in_list, used[g], t), isolated, LANES::sub(isolated, one)); \
+	auto const at_top = LANES::equal(level[g], zero);			\
+	if (auto const top = LANES::mask_bits(LANES::mask_and(fits, at_top)); top != 0) [[unlikely]] { \
+		alignas(64) std::array<board_bitmask_t, LANES::width> u;	\
+		LANES::store(u.data(), next_used);				\
+		auto const failed = top & ~flood_fill_check_(top, u.data());	\
+		fits = LANES::mask_andnot(fits, LANES::mask_of_bits(failed));	\
+	}									\
+										\
+	auto const out_of_list = LANES::mask_andnot(busy[g], in_list);		\
+	solved[g] = LANES::mask_and(fits, LANES::equal(level[g], last_level));	\
+	finished[g] = LANES::mask_or(solved[g], LANES::mask_and(out_of_list, at_top)); \
+	auto const push = LANES::mask_andnot(fits, solved[g]);			\
+	auto const pop = LANES::mask_andnot(out_of_list, at_top);		\
+										\
+	/* Going down a level: remember where we were */			\
+	stack[g] = LANES::select(push, LANES::bit_or(stack[g], LANES::shift_left(position[g], byte_shift)), stack[g]); \
+	used[g] = LANES::select(push, next_used, used[g]);			\
+	/* Going back up: take off the piece we placed there, and carry on */ \
+	/* from just past it */							\
+	auto const up_shift = LANES::sub(byte_shift, eight);			\
+	auto const up_position = LANES::bit_and(LANES::shift_right(stack[g], up_shift), ff); \
+	if (LANES::mask_bits(pop) != 0) {					\
+		auto const up_idx = LANES::add(offsets, LANES::add(LANES::mul(LANES::sub(level[g], one), level_size), up_position)); \
+		used[g] = LANES::bit_xor(used[g], LANES::gather(pop, base, up_idx)); \
+		stack[g] = LANES::select(pop, LANES::bit_andnot(LANES::shift_left(ff, up_shift), stack[g]), stack[g]); \
+	}									\
+	position[g] = LANES::select(push, zero, LANES::add(LANES::select(pop, up_position, position[g]), one)); \
+	level[g] = LANES::select(push, LANES::add(level[g], one), LANES::select(pop, LANES::sub(level[g], one), level[g])); \
+} while (0)
+
+// The whole search, for one instruction set.  This can't be a template
+// because each instruction set's version has to be compiled for it.
+#define LOCKSTEP_RUN(LANES)							\
+do {										\
+	auto const offsets = LANES::load(lockstep_lane_offsets.data());	\
+	auto const all = LANES::splat(all_squares);				\
+	auto const not_first_column = LANES::splat(~first_column);		\
+	auto const not_last_column = LANES::splat(~last_column);		\
+	auto const ff = LANES::splat(0xFF);					\
+	auto const zero = LANES::zero();					\
+	auto const one = LANES::splat(1);					\
+	auto const eight = LANES::splat(8);					\
+	auto const last_level = LANES::splat(num_levels - 1);			\
+	auto const level_size = LANES::splat(max_placements_per_piece);		\
+										\
+	while (busy_lanes_ != 0) {						\
+		LANES::vec used[num_groups], level[num_groups], position[num_groups]; \
+		LANES::vec lengths[num_groups], stack[num_groups];		\
+		LANES::mask busy[num_groups], solved[num_groups], finished[num_groups]; \
+		for (unsigned g = 0; g < num_groups; g++) {			\
+			auto const first = g * LANES::width;			\
+			used[g] = LANES::load(&used_[first]);			\
+			level[g] = LANES::load(&level_[first]);			\
+			position[g] = LANES::load(&position_[first]);		\
+			lengths[g] = LANES::load(&lengths_[first]);		\
+			stack[g] = LANES::load(&stack_[first]);			\
+			unsigned bits = 0;					\
+			for (unsigned i = 0; i < LANES::width; i++)		\
+				if (board_of_[first + i] != no_board)		\
+					bits |= 1u << i;			\
+			busy[g] = LANES::mask_of_bits(bits);			\
+		}								\
+		static_assert(num_groups == 2);					\
+		for (;;) {							\
+			LOCKSTEP_STEP(LANES, 0);				\
+			LOCKSTEP_STEP(LANES, 1);				\
+			if ((LANES::mask_bits(finished[0]) | LANES::mask_bits(finished[1])) != 0) \
+				break;						\
+		}								\
+		for (unsigned g = 0; g < num_groups; g++) {			\
+			auto const first = g * LANES::width;			\
+			LANES::store(&used_[first], used[g]);			\
+			LANES::store(&level_[first], level[g]);			\
+			LANES::store(&position_[first], position[g]);		\
+			LANES::store(&lengths_[first], lengths[g]);		\
+			LANES::store(&stack_[first], stack[g]);			\
+			auto const solved_bits = LANES::mask_bits(solved[g]);	\
+			for (auto bits = LANES::mask_bits(finished[g]); bits != 0; bits &= bits - 1) { \
+				auto const i = static_cast<unsigned>(std::countr_zero(bits)); \
+				finish_lane_(first + i, (solved_bits & (1u << i)) != 0); \
+			}							\
+		}								\
+	}									\
+} while (0)
+
+[[gnu::target("avx512f")]] auto lockstep_solver::run_avx512_() noexcept -> void
+{
+	LOCKSTEP_RUN(avx512_lanes);
+}
+
+[[gnu::target("avx2")]] auto lockstep_solver::run_avx2_() noexcept -> void
+{
+	LOCKSTEP_RUN(avx2_lanes);
+}
+
+#undef LOCKSTEP_STEP
+#undef LOCKSTEP_RUN
+
+auto lockstep_solver::solve(std::span<board_bitmask_t const> boards, std::span<std::optional<placement_indices_t>> solutions) noexcept -> bool
+{
+	if (__builtin_cpu_supports("avx512f")) {
+		lockstep_solver s(boards, solutions, num_groups * avx512_lanes::width);
+		s.run_avx512_();
+		return true;
 	}
-	// We can try to solve any board with 7 blockers, but at least
-	// print a warning if this isn't one that is reachable using the
-	// game's standard dice, since then we may not have a solution:
-	auto const valid_roll = blockers_are_valid_roll(blockers);
-	if (not valid_roll)
-		[[unlikely]] fputs("Warning: given board is not a valid dice roll\n", stderr);
-	board b(blockers);
-	if (not b.solve()) {
-		[[unlikely]] puts("No solution.");
+	if (__builtin_cpu_supports("avx2")) {
+		lockstep_solver s(boards, solutions, num_groups * avx2_lanes::width);
+		s.run_avx2_();
+		return true;
+	}
+	return false;
+}
+
+#else // !__x86_64__
+
+class lockstep_solver {
+    public:
+	[[nodiscard]] static auto solve(std::span<board_bitmask_t const> /* boards */, std::span<std::optional<placement_indices_t>> /* solutions */) noexcept -> bool
+	{
+		return false;
+	}
+};
+
+#endif // __x86_64__
+
+// Totals over every entry in placements_by_cell, for sizing the
+// dancing-links matrix to fit an empty board
+[[nodiscard]] static auto consteval count_all_placements() noexcept -> unsigned
+{
+	unsigned rv = 0;
+	for (unsigned cell = 0; cell < 36; cell++)
+		rv += placements_by_cell.count[cell];
+	return rv;
+}
+[[nodiscard]] static auto consteval count_all_placement_bits() noexcept -> unsigned
+{
+	unsigned rv = 0;
+	for (unsigned cell = 0; cell < 36; cell++)
+		for (auto const t : placements_by_cell.placements_at(cell))
+			rv += static_cast<unsigned>(std::popcount(t));
+	return rv;
+}
+
+// Knuth's "Algorithm X" using dancing links.  The board is modelled as an
+// exact-cover matrix with one column for each of the 36 squares plus one
+// for each of the 9 pieces, and one row for each placement of each piece
+// (the same encoding used by placements_by_cell).  Squares taken by the
+// blockers don't get a column, and placements that overlap them don't get
+// a row.  At each step we branch on the column with the fewest rows left,
+// which lets the search notice a dead end as soon as any square or piece
+// has nowhere left to go.
+class dlx_matrix {
+    public:
+	explicit dlx_matrix(board_bitmask_t blockers) noexcept
+	{
+		// Node 0 is the root, nodes 1..num_columns are the column headers
+		for (unsigned i = 0; i <= num_columns; i++) {
+			nodes_[i].left = static_cast<std::uint16_t>(i);
+			nodes_[i].right = static_cast<std::uint16_t>(i);
+			nodes_[i].up = static_cast<std::uint16_t>(i);
+			nodes_[i].down = static_cast<std::uint16_t>(i);
+			nodes_[i].column = static_cast<std::uint16_t>(i);
+			sizes_[i] = 0;
+		}
+		for (unsigned bit = 0; bit < num_columns; bit++)
+			if ((blockers & (static_cast<board_bitmask_t>(1) << bit)) == 0)
+				link_horizontally_(nodes_[0].left, static_cast<std::uint16_t>(bit + 1));
+		num_nodes_ = num_columns + 1;
+		num_rows_ = 0;
+
+		for (unsigned cell = 0; cell < 36; cell++)
+			for (auto const t : placements_by_cell.placements_at(cell))
+				if ((t & blockers) == 0)
+					add_row_(t);
+	}
+
+	// Calls on_solved(placed) for each solution, where 'placed' is the
+	// list of rows chosen.  Stops as soon as that returns true.
+	template<typename STATS, typename F>
+	[[nodiscard]] auto search(STATS& stats, F const& on_solved) noexcept -> bool
+	{
+		return search_(0, stats, on_solved);
+	}
+
+    private:
+	static constexpr unsigned num_columns = piece_bit_shift + 9;
+	static constexpr unsigned max_rows = count_all_placements();
+	// One node per bit in each row, plus the root and column headers
+	static constexpr unsigned max_nodes = 1 + num_columns + count_all_placement_bits();
+
+	struct node {
+		std::uint16_t left, right, up, down;
+		std::uint16_t column;
+		std::uint16_t row;
+	};
+
+	std::array<node, max_nodes> nodes_;
+	std::array<unsigned, num_columns + 1> sizes_;
+	std::array<board_bitmask_t, max_rows> rows_;
+	std::array<board_bitmask_t, 9> placed_;
+	unsigned num_nodes_;
+	unsigned num_rows_;
+
+	// Insert node 'n' to the right of node 'after'
+	auto link_horizontally_(std::uint16_t after, std::uint16_t n) noexcept -> void
+	{
+		nodes_[n].left = after;
+		nodes_[n].right = nodes_[after].right;
+		nodes_[nodes_[after].right].left = n;
+		nodes_[after].right = n;
+	}
+
+	auto add_row_(board_bitmask_t t) noexcept -> void
+	{
+		assert(num_rows_ < max_rows);
+		auto const row = static_cast<std::uint16_t>(num_rows_++);
+		rows_[row] = t;
+		std::uint16_t first = 0;
+		for (auto bits = t; bits != 0; bits &= bits - 1) {
+			assert(num_nodes_ < max_nodes);
+			auto const n = static_cast<std::uint16_t>(num_nodes_++);
+			auto const col = static_cast<std::uint16_t>(std::countr_zero(bits) + 1);
+			auto& nd = nodes_[n];
+			nd.column = col;
+			nd.row = row;
+			// Append to the bottom of the column
+			nd.down = col;
+			nd.up = nodes_[col].up;
+			nodes_[nodes_[col].up].down = n;
+			nodes_[col].up = n;
+			sizes_[col]++;
+			if (first == 0) {
+				first = n;
+				nd.left = n;
+				nd.right = n;
+			} else {
+				link_horizontally_(nodes_[first].left, n);
+			}
+		}
+	}
+
+	auto cover_(unsigned col) noexcept -> void
+	{
+		nodes_[nodes_[col].right].left = nodes_[col].left;
+		nodes_[nodes_[col].left].right = nodes_[col].right;
+		for (auto i = nodes_[col].down; i != col; i = nodes_[i].down) {
+			for (auto j = nodes_[i].right; j != i; j = nodes_[j].right) {
+				nodes_[nodes_[j].down].up = nodes_[j].up;
+				nodes_[nodes_[j].up].down = nodes_[j].down;
+				sizes_[nodes_[j].column]--;
+			}
+		}
+	}
+
+	auto uncover_(unsigned col) noexcept -> void
+	{
+		for (auto i = nodes_[col].up; i != col; i = nodes_[i].up) {
+			for (auto j = nodes_[i].left; j != i; j = nodes_[j].left) {
+				sizes_[nodes_[j].column]++;
+				nodes_[nodes_[j].down].up = j;
+				nodes_[nodes_[j].up].down = j;
+			}
+		}
+		nodes_[nodes_[col].right].left = static_cast<std::uint16_t>(col);
+		nodes_[nodes_[col].left].right = static_cast<std::uint16_t>(col);
+	}
+
+	template<typename STATS, typename F>
+	[[nodiscard]] auto search_(unsigned depth, STATS& stats, F const& on_solved) noexcept -> bool
+	{
+		if (nodes_[0].right == 0) {
+			assert(depth == placed_.size());
+			stats.solved();
+			return on_solved(std::span<board_bitmask_t const, 9>(placed_));
+		}
+
+		// Branch on the column with the fewest choices left
+		unsigned col = nodes_[0].right;
+		for (unsigned c = nodes_[col].right; c != 0 and sizes_[col] > 1; c = nodes_[c].right)
+			if (sizes_[c] < sizes_[col])
+				col = c;
+		if (sizes_[col] == 0)
+			return false;
+
+		cover_(col);
+		for (auto r = nodes_[col].down; r != col; r = nodes_[r].down) {
+			placed_[depth] = rows_[nodes_[r].row];
+			// Every row still in the matrix fits, since covering a
+			// column removes all of the rows that conflict with it
+			stats.tested(piece_of_placement(placed_[depth]));
+			stats.passed(piece_of_placement(placed_[depth]));
+			stats.placed(piece_of_placement(placed_[depth]), depth + 1);
+			for (auto j = nodes_[r].right; j != r; j = nodes_[j].right)
+				cover_(nodes_[j].column);
+			if (search_(depth + 1, stats, on_solved))
+				return true;
+			for (auto j = nodes_[r].left; j != r; j = nodes_[j].left)
+				uncover_(nodes_[j].column);
+		}
+		uncover_(col);
+		return false;
+	}
+};
+
+// Unlike the loop nest this one does place the single-square piece, since
+// the lowest empty square may well be where it needs to go.  Every piece
+// has to fill the lowest empty square when it's placed, so each tiling
+// of the board is found exactly once.
+template<typename STATS, typename F>
+auto board::cover_lowest_square_(board_bitmask_t used, board_bitmask_t *placed, STATS& stats, F const& on_solved) noexcept -> bool
+{
+	if (used == all_squares_and_pieces) {
+		stats.solved();
+		return on_solved();
+	}
+	auto const cell = static_cast<unsigned>(std::countr_zero(~used));
+	assert(cell < piece_bit_shift);
+	for (auto const t : placements_by_cell.placements_at(cell)) {
+		stats.tested(piece_of_placement(t));
+		if ((t & used) == 0) {
+			*placed = t;
+			stats.passed(piece_of_placement(t));
+			stats.placed(piece_of_placement(t), static_cast<unsigned>(std::popcount(used >> piece_bit_shift)) + 1);
+			if (cover_lowest_square_(used | t, placed + 1, stats, on_solved))
+				return true;
+		}
+	}
+	return false;
+}
+
+// Looking up every state would cost more than it saves, since near the
+// end of the search there is so little left to do.  So the memo engine
+// only bothers for states with at least this many empty squares.
+static constexpr int memo_min_empty_squares = 8;
+
+template<typename STATS>
+auto board::count_covers_memo_(board_bitmask_t used, memo_table& memo, STATS& stats) noexcept -> unsigned
+{
+	if (used == all_squares_and_pieces) {
+		stats.solved();
+		return 1;
+	}
+	auto const worth_remembering = std::popcount(~used & all_squares) >= memo_min_empty_squares;
+	unsigned count = 0;
+	if (worth_remembering and memo.lookup(used, count)) {
+		stats.reused(count);
+		return count;
+	}
+	auto const cell = static_cast<unsigned>(std::countr_zero(~used));
+	assert(cell < piece_bit_shift);
+	for (auto const t : placements_by_cell.placements_at(cell)) {
+		stats.tested(piece_of_placement(t));
+		if ((t & used) == 0) {
+			stats.passed(piece_of_placement(t));
+			stats.placed(piece_of_placement(t), static_cast<unsigned>(std::popcount(used >> piece_bit_shift)) + 1);
+			count += count_covers_memo_(used | t, memo, stats);
+		}
+	}
+	if (worth_remembering)
+		memo.store(used, count);
+	return count;
+}
+
+auto board::record_placements_(std::span<board_bitmask_t const, 9> placed) noexcept -> void
+{
+	for (auto const t : placed) {
+		auto const piece = static_cast<unsigned>(piece_of_placement(t));
+		if (piece != static_cast<unsigned>(piece_id::single_block))
+			this->*piece_member_[piece] = t & all_squares;
+	}
+	assert_consistent_();
+}
+
+auto board::solve() noexcept -> bool
+{
+	no_search_stats stats;
+	return solve(stats);
+}
+
+auto board::count_solutions() noexcept -> unsigned
+{
+	no_search_stats stats;
+	return count_solutions(stats);
+}
+
+template<typename STATS>
+auto board::solve(STATS& stats) noexcept -> bool
+{
+	stats.begin();
+	auto const rv = solve_with_engine_(stats);
+	stats.end();
+	return rv;
+}
+
+template<typename STATS>
+auto board::count_solutions(STATS& stats) noexcept -> unsigned
+{
+	stats.begin();
+	auto const rv = count_solutions_with_engine_(stats);
+	stats.end();
+	return rv;
+}
+
+template<typename STATS>
+auto board::solve_with_engine_(STATS& stats) noexcept -> bool
+{
+	switch (engine_) {
+	    case solver_engine::loop_nest:
+	    case solver_engine::simd:
+		return solve_loop_nest_(stats);
+	    // Looking for just one solution doesn't come back to the same
+	    // states often enough for the memo engine to help
+	    case solver_engine::cell_driven:
+	    case solver_engine::memo: {
+		std::array<board_bitmask_t, 9> placed;
+		if (not cover_lowest_square_(blockers_, placed.data(), stats, [] { return true; }))
+			return false;
+		record_placements_(placed);
+		return true;
+	    }
+	    case solver_engine::dlx: {
+		dlx_matrix m(blockers_);
+		return m.search(stats, [this](std::span<board_bitmask_t const, 9> placed) {
+			record_placements_(placed);
+			return true;
+		});
+	    }
+	    case solver_engine::narrowing:
+		return narrowing_search_(stats, [] { return true; });
+	}
+	[[unlikely]] abort();
+}
+
+template<typename STATS>
+auto board::count_solutions_with_engine_(STATS& stats) noexcept -> unsigned
+{
+	switch (engine_) {
+	    case solver_engine::loop_nest:
+	    case solver_engine::simd:
+		return count_solutions_loop_nest_(stats);
+	    case solver_engine::cell_driven: {
+		std::array<board_bitmask_t, 9> placed;
+		unsigned count = 0;
+		static_cast<void>(cover_lowest_square_(blockers_, placed.data(), stats, [&] {
+#ifndef NDEBUG
+			record_placements_(placed);
+#endif
+			count++;
+			return false;
+		}));
+		return count;
+	    }
+	    case solver_engine::dlx: {
+		dlx_matrix m(blockers_);
+		unsigned count = 0;
+		static_cast<void>(m.search(stats, [&](std::span<board_bitmask_t const, 9> placed) {
+#ifndef NDEBUG
+			record_placements_(placed);
+#else
+			static_cast<void>(placed);
+#endif
+			count++;
+			return false;
+		}));
+		return count;
+	    }
+	    case solver_engine::narrowing: {
+		unsigned count = 0;
+		static_cast<void>(narrowing_search_(stats, [&count] {
+			count++;
+			return false;
+		}));
+		return count;
+	    }
+	    case solver_engine::memo: {
+		if (memo_ != nullptr)
+			return count_covers_memo_(blockers_, *memo_, stats);
+		// Otherwise each thread keeps a table of its own for every
+		// board it counts, rather than allocating one each time.  The
+		// entries include the blockers, so any left over from other
+		// boards are still right.
+		thread_local memo_table memo(lone_memo_log2_entries);
+		return count_covers_memo_(blockers_, memo, stats);
+	    }
+	}
+	[[unlikely]] abort();
+}
+
+auto board::placement_indices() const noexcept -> placement_indices_t
+{
+	placement_indices_t rv;
+	for (unsigned i = 0; i < placed_pieces.size(); i++) {
+		auto const piece = static_cast<unsigned>(placed_pieces[i]);
+		auto const placements = placements_of_piece[piece];
+		auto const it = std::find(placements.begin(), placements.end(), this->*piece_member_[piece]);
+		assert(it != placements.end());
+		rv[i] = static_cast<std::uint8_t>(it - placements.begin());
+	}
+	return rv;
+}
+
+auto board::set_placements(placement_indices_t const& indices) noexcept -> void
+{
+	for (unsigned i = 0; i < placed_pieces.size(); i++) {
+		auto const piece = static_cast<unsigned>(placed_pieces[i]);
+		assert(indices[i] < placements_of_piece[piece].size());
+		this->*piece_member_[piece] = placements_of_piece[piece][indices[i]];
+	}
+	assert_consistent_();
+}
+
+auto board::set_transformed(board const& solved, unsigned symmetry) noexcept -> void
+{
+	assert(solved.blockers_ == transform_board(this->blockers_, symmetry));
+	auto const inverse = inverse_symmetry[symmetry];
+	for (auto const piece : placed_pieces) {
+		auto const member = piece_member_[static_cast<unsigned>(piece)];
+		this->*member = transform_board(solved.*member, inverse);
+	}
+	assert_consistent_();
+}
+
+#ifndef NDEBUG
+auto board::assert_consistent_() const noexcept -> void
+{
+	auto const all_bits = this->blockers_ | this->line4_ | this->square2_2_ | this->lblock3_ | this->zblock_ | this->tblock_ | this->line3_ | this->lblock2_ | this->line2_;
+	// Cheap check to make sure no blocks got placed on top each other:
+	assert(all_bits ==
+	  (this->blockers_ + this->line4_ + this->square2_2_ + this->lblock3_ + this->zblock_ + this->tblock_ + this->line3_ + this->lblock2_ + this->line2_));
+	// Verify that there is exactly one unplaced spot (i.e.
+	// where the single square will go)
+	auto const unused_bits = 0xF'FFFF'FFFFull ^ all_bits;
+	assert(unused_bits != 0);
+	assert((unused_bits & (unused_bits - 1)) == 0);
+}
+#endif // !NDEBUG
+
+auto board::piece_map_() const noexcept -> std::array<piece_id, 36>
+{
+	std::array<piece_id, 36> rv;
+	// Whatever square is left over is where the single square goes
+	rv.fill(piece_id::single_block);
+	auto const mark = [&rv](board_bitmask_t squares, piece_id piece) {
+		for (; squares != 0; squares &= squares - 1)
+			rv[static_cast<unsigned>(std::countr_zero(squares))] = piece;
+	};
+	mark(blockers_, piece_id::blockers);
+	for (auto const piece : placed_pieces)
+		mark(this->*piece_member_[static_cast<unsigned>(piece)], piece);
+	return rv;
+}
+
+// The length of each of the piece_rendering strings
+static constexpr auto piece_rendering_lengths = [] {
+	std::array<std::size_t, piece_rendering.size()> lengths;
+	for (unsigned i = 0; i < piece_rendering.size(); i++)
+		lengths[i] = std::char_traits<char>::length(piece_rendering[i]);
+	return lengths;
+}();
+
+auto board::render(std::span<char> out, output_format format) const noexcept -> std::size_t
+{
+	assert(out.size() >= max_rendered_board_size);
+	std::size_t n = 0;
+	auto const append = [&out, &n](std::string_view str) {
+		memcpy(&out[n], str.data(), str.size());
+		n += str.size();
+	};
+	auto const append_number = [&out, &n](std::uint64_t x) {
+		n = static_cast<std::size_t>(std::to_chars(&out[n], out.data() + out.size(), x).ptr - out.data());
+	};
+
+	switch (format) {
+	    case output_format::ansi: {
+		auto const pieces = piece_map_();
+		for (unsigned row = 0; row < 6; row++) {
+			for (unsigned col = 0; col < 6; col++) {
+				auto const p = static_cast<unsigned>(pieces[row * 6 + col]);
+				assert(p < piece_rendering.size());
+				append(std::string_view(piece_rendering[p], piece_rendering_lengths[p]));
+			}
+			out[n++] = '\n';
+		}
+		return n;
+	    }
+	    case output_format::compact: {
+		for (auto const piece : piece_map_())
+			out[n++] = compact_rendering[static_cast<unsigned>(piece)];
+		out[n++] = '\n';
+		return n;
+	    }
+	    case output_format::bin: {
+		for (unsigned i = 0; i < 8; i++)
+			out[n++] = static_cast<char>(blockers_ >> (8 * i));
+		for (auto const index : placement_indices())
+			out[n++] = static_cast<char>(index);
+		assert(n == bin_record_size);
+		return n;
+	    }
+	    case output_format::ndjson: {
+		append("{\"blockers\":");
+		append_number(blockers_);
+		append(",\"placements\":{");
+		auto const indices = placement_indices();
+		for (unsigned i = 0; i < placed_pieces.size(); i++) {
+			append(i == 0 ? "\"" : ",\"");
+			append(piece_names[static_cast<unsigned>(placed_pieces[i])]);
+			append("\":");
+			append_number(indices[i]);
+		}
+		append("},\"board\":\"");
+		for (auto const piece : piece_map_())
+			out[n++] = compact_rendering[static_cast<unsigned>(piece)];
+		append("\"}\n");
+		return n;
+	    }
+	}
+	[[unlikely]] abort();
+}
+
+auto board::render(std::string& out, output_format format) const noexcept -> void
+{
+	auto const old_size = out.size();
+	out.resize(old_size + max_rendered_board_size);
+	out.resize(old_size + render(std::span(out).subspan(old_size), format));
+}
+
+auto board::print(output_format format) const noexcept -> void
+{
+	std::array<char, max_rendered_board_size> out;
+	fwrite(out.data(), 1, render(out, format), stdout);
+}
+
+// Append what gets written instead of a solved board when 'blockers' has
+// no solution
+static auto render_no_solution(board_bitmask_t blockers, output_format format, std::string& out) noexcept -> void
+{
+	switch (format) {
+	    case output_format::ansi:
+	    case output_format::compact:
+		out += "No solution.\n";
+		return;
+	    case output_format::bin:
+		for (unsigned i = 0; i < 8; i++)
+			out += static_cast<char>(blockers >> (8 * i));
+		out.append(placed_pieces.size(), static_cast<char>(no_solution_index));
+		return;
+	    case output_format::ndjson:
+		out += "{\"blockers\":";
+		out += std::to_string(blockers);
+		out += ",\"placements\":null}\n";
+		return;
+	}
+	[[unlikely]] abort();
+}
+
+[[maybe_unused]] static auto print_no_solution(board_bitmask_t blockers, output_format format) noexcept -> void
+{
+	std::string out;
+	render_no_solution(blockers, format, out);
+	fwrite(out.data(), 1, out.size(), stdout);
+}
+
+// Options that affect how the whole-space modes do their work
+class roll_database;
+
+struct run_options {
+	// Number of worker threads; 1 means just run on the main thread
+	unsigned num_threads = 1;
+	// Search algorithm used to solve each board
+	solver_engine engine = solver_engine::loop_nest;
+	// Look up dice rolls in the precomputed table instead of searching
+	bool use_roll_table = true;
+	// Only search one of each set of boards that are rotations or
+	// reflections of each other (see canonical_blockers())
+	bool use_symmetry = true;
+	// How to write out solved boards
+	output_format format = output_format::ansi;
+	// Print a search_stats summary to stderr at the end
+	bool stats = false;
+	// A file written by "--census" to check boards that aren't dice
+	// rolls against, or null
+	char const *census_path = nullptr;
+	// A file written by "--build-db" to use instead of the roll table,
+	// or null.  main() opens it and sets 'db'.
+	char const *db_path = nullptr;
+	roll_database const *db = nullptr;
+	// "--shard K/N": only do the K'th of N equal parts of the dice
+	// rolls (see shard_rolls())
+	unsigned shard = 1;
+	unsigned num_shards = 1;
+	// "--solutions N": how many solutions to print when solving a
+	// single board, with 0 meaning all of them
+	unsigned max_solutions = 1;
+};
+
+// search_stats being added up from several threads at once
+class shared_search_stats {
+    public:
+	auto add(search_stats const& stats) noexcept -> void
+	{
+		std::lock_guard<std::mutex> const guard(lock_);
+		total_ += stats;
+	}
+
+	[[nodiscard]] auto total() const noexcept -> search_stats const&
+	{
+		return total_;
+	}
+
+    private:
+	std::mutex lock_;
+	search_stats total_;
+};
+
+// Run search(stats) with no_search_stats, unless 'shared' is non-null in
+// which case it gets a search_stats that's then added into 'shared'.  This
+// only gets checked once per board, so when nobody asked for statistics the
+// search itself runs at full speed.
+template<typename F>
+static auto search_maybe_with_stats(shared_search_stats *shared, F const& search) noexcept
+{
+	if (shared == nullptr) {
+		no_search_stats stats;
+		return search(stats);
+	}
+	search_stats stats;
+	auto const rv = search(stats);
+	shared->add(stats);
+	return rv;
+}
+
+// Solve each of 'boards', putting where the pieces went (or std::nullopt
+// if there's no solution) in the same position of 'solutions'.  The SIMD
+// engine solves them all together, if the CPU can; otherwise, or when
+// collecting statistics, they get solved one at a time.
+static auto solve_boards(std::span<board_bitmask_t const> boards, std::span<std::optional<placement_indices_t>> solutions,
+			 solver_engine engine, shared_search_stats *stats) noexcept -> void
+{
+	assert(boards.size() == solutions.size());
+	if (engine == solver_engine::simd and stats == nullptr and lockstep_solver::solve(boards, solutions))
+		return;
+	for (std::size_t i = 0; i < boards.size(); i++) {
+		board b(boards[i], engine);
+		if (search_maybe_with_stats(stats, [&b](auto& s) { return b.solve(s); }))
+			solutions[i] = b.placement_indices();
+		else
+			[[unlikely]] solutions[i] = std::nullopt;
+	}
+}
+
+// "--stats": write a summary of what the search did to stderr
+[[maybe_unused]] static auto print_search_stats(search_stats const& stats) noexcept -> void
+{
+	fprintf(stderr, "Searched %llu boards, found %llu solutions\n",
+		static_cast<unsigned long long>(stats.boards),
+		static_cast<unsigned long long>(stats.solutions));
+	if (stats.reuses != 0)
+		fprintf(stderr, "Reused %llu previous answers\n", static_cast<unsigned long long>(stats.reuses));
+	fprintf(stderr, "%-14s %14s %14s %14s\n", "piece", "tested", "no overlap", "placed");
+	auto const print_piece = [&stats](piece_id piece) {
+		auto const p = static_cast<unsigned>(piece);
+		fprintf(stderr, "%-14s %14llu %14llu %14llu\n", piece_names[p],
+			static_cast<unsigned long long>(stats.tests[p]),
+			static_cast<unsigned long long>(stats.passes[p]),
+			static_cast<unsigned long long>(stats.nodes[p]));
+	};
+	for (auto const piece : placed_pieces)
+		print_piece(piece);
+	// Only some engines place this one
+	if (stats.tests[static_cast<unsigned>(piece_id::single_block)] != 0)
+		print_piece(piece_id::single_block);
+
+	unsigned deepest = 0;
+	for (unsigned i = 0; i < stats.dead_ends.size(); i++)
+		if (stats.dead_ends[i] != 0)
+			deepest = i;
+	fprintf(stderr, "%-14s %14s\n", "pieces placed", "dead ends");
+	for (unsigned i = 0; i <= deepest; i++)
+		fprintf(stderr, "%-14u %14llu\n", i, static_cast<unsigned long long>(stats.dead_ends[i]));
+}
+
+// Spreads the work of processing the index range [0, total) over a set of
+// threads.  Each thread owns a deque of index ranges: it pops work from the
+// back of its own deque and, once that runs dry, steals from the front of
+// somebody else's.  Large ranges get split in half before they're worked on
+// and the unused half is left in the deque, so there's always something
+// coarse-grained available to steal.  Since some boards take far longer to
+// solve than others this keeps all of the threads busy until the very end.
+// A thread that finds nothing to steal sleeps until another one leaves a
+// range in its deque, or until all of the work is done.
+class work_stealing_scheduler {
+    public:
+	explicit work_stealing_scheduler(unsigned num_threads) noexcept
+		: queues_(num_threads)
+	{
+		assert(num_threads > 0);
+	}
+
+	// Call func(thread_index, first, last) for non-overlapping ranges that
+	// together cover [0, total), none of which are larger than 'grain'.
+	// Returns once all of them are done.
+	template<typename F>
+	auto run(unsigned total, unsigned grain, F const& func) noexcept -> void
+	{
+		assert(grain > 0);
+		auto const num_threads = static_cast<unsigned>(queues_.size());
+
+		// Start each thread off with its own contiguous piece of the work
+		for (unsigned i = 0; i < num_threads; i++) {
+			auto const first = static_cast<unsigned>(static_cast<std::uint64_t>(total) * i / num_threads);
+			auto const last = static_cast<unsigned>(static_cast<std::uint64_t>(total) * (i + 1) / num_threads);
+			if (first < last)
+				queues_[i].ranges.push_back({ first, last });
+		}
+		remaining_.store(total, std::memory_order_relaxed);
+
+		std::vector<std::thread> threads;
+		threads.reserve(num_threads - 1);
+		for (unsigned i = 1; i < num_threads; i++)
+			threads.emplace_back([this, i, grain, &func] { this->worker_(i, grain, func); });
+		worker_(0, grain, func);
+		for (auto& t : threads)
+			t.join();
+		assert(remaining_.load() == 0);
+	}
+
+    private:
+	struct range {
+		unsigned first;
+		unsigned last;
+	};
+
+	// Each queue gets its own cache line so that threads working on
+	// their own deque don't fight over the same memory
+	struct alignas(64) queue {
+		std::mutex lock;
+		std::deque<range> ranges;
+	};
+
+	std::vector<queue> queues_;
+	// Number of indices that haven't been processed yet
+	std::atomic<unsigned> remaining_;
+	// Number of threads sleeping in wait_for_work_()
+	std::atomic<unsigned> idle_ { 0 };
+	// Goes up whenever there's something for a sleeping thread to
+	// wake up for.  They wait() on it.
+	std::atomic<unsigned> changes_ { 0 };
+
+	[[nodiscard]] auto pop_local_(unsigned self, range& r) noexcept -> bool
+	{
+		auto& q = queues_[self];
+		std::lock_guard<std::mutex> const guard(q.lock);
+		if (q.ranges.empty())
+			return false;
+		r = q.ranges.back();
+		q.ranges.pop_back();
+		return true;
+	}
+
+	[[nodiscard]] auto steal_(unsigned self, range& r) noexcept -> bool
+	{
+		auto const num_threads = static_cast<unsigned>(queues_.size());
+		for (unsigned i = 1; i < num_threads; i++) {
+			auto& q = queues_[(self + i) % num_threads];
+			std::lock_guard<std::mutex> const guard(q.lock);
+			if (not q.ranges.empty()) {
+				r = q.ranges.front();
+				q.ranges.pop_front();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Nothing left to grab, but other threads might still be splitting
+	// up the ranges they are holding.  Sleep until one of them leaves
+	// something to steal and return it in 'r', or return false once
+	// everything has been processed.  Only this thread ever adds to its
+	// own deque, so there's no need to look there.
+	[[nodiscard]] auto wait_for_work_(unsigned self, range& r) noexcept -> bool
+	{
+		idle_.fetch_add(1);
+		auto found = false;
+		for (;;) {
+			// Anything that changes after this makes the wait()
+			// return straight away, so nothing gets missed
+			auto const seen = changes_.load(std::memory_order_acquire);
+			if (remaining_.load(std::memory_order_acquire) == 0)
+				break;
+			if (steal_(self, r)) {
+				found = true;
+				break;
+			}
+			changes_.wait(seen, std::memory_order_acquire);
+		}
+		idle_.fetch_sub(1);
+		return found;
+	}
+
+	// Wake up a sleeping thread, if there are any, after leaving
+	// something in a deque for it to steal.  The range was added under
+	// the deque's lock, so a thread that isn't counted in idle_ yet is
+	// certain to find it when it looks.
+	auto wake_idle_() noexcept -> void
+	{
+		if (idle_.load() == 0)
+			return;
+		changes_.fetch_add(1, std::memory_order_release);
+		changes_.notify_one();
+	}
+
+	template<typename F>
+	auto worker_(unsigned self, unsigned grain, F const& func) noexcept -> void
+	{
+		for (;;) {
+			range r;
+			if (not pop_local_(self, r) and not steal_(self, r) and not wait_for_work_(self, r))
+				return;
+			while (r.last - r.first > grain) {
+				auto const mid = r.first + (r.last - r.first) / 2;
+				{
+					auto& q = queues_[self];
+					std::lock_guard<std::mutex> const guard(q.lock);
+					q.ranges.push_back({ mid, r.last });
+				}
+				wake_idle_();
+				r.last = mid;
+			}
+			func(self, r.first, r.last);
+			auto const n = r.last - r.first;
+			if (remaining_.fetch_sub(n, std::memory_order_acq_rel) == n) {
+				// That was the last of it, so everyone can stop
+				changes_.fetch_add(1, std::memory_order_release);
+				changes_.notify_all();
+			}
+		}
+	}
+};
+
+// Compute compute(index) for every index in [0, total) using 'num_threads'
+// worker threads, but hand the results to emit(index, result) strictly in
+// index order on the calling thread.  Results that finish out of order wait
+// in a fixed-size ring (the "reorder buffer") until everything before them
+// has been emitted.  Workers that get a whole ring ahead of the output stall
+// until it catches up, so memory use doesn't grow with 'total' and output
+// keeps streaming out as the work progresses.
+template<typename T, typename COMPUTE, typename EMIT>
+static auto ordered_parallel_for(unsigned num_threads, unsigned total, COMPUTE const& compute, EMIT const& emit) noexcept -> void
+{
+	if (num_threads <= 1) {
+		for (unsigned i = 0; i < total; i++)
+			emit(i, compute(i));
+		return;
+	}
+
+	struct slot {
+		std::atomic<bool> ready { false };
+		T value;
+	};
+	auto const window = 256 * num_threads;
+	std::vector<slot> ring(window);
+	std::atomic<unsigned> next_index { 0 };	// next index for a worker to claim
+	std::atomic<unsigned> emitted { 0 };	// number of indices already emitted
+
+	auto const worker = [&] {
+		for (;;) {
+			auto const i = next_index.fetch_add(1, std::memory_order_relaxed);
+			if (i >= total)
+				return;
+			// Don't get so far ahead that we'd clobber a slot
+			// that is still waiting to be emitted
+			for (auto e = emitted.load(std::memory_order_acquire); i >= e + window; e = emitted.load(std::memory_order_acquire))
+				emitted.wait(e, std::memory_order_acquire);
+			auto& s = ring[i % window];
+			s.value = compute(i);
+			s.ready.store(true, std::memory_order_release);
+			s.ready.notify_one();
+		}
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(num_threads);
+	for (unsigned i = 0; i < num_threads; i++)
+		threads.emplace_back(worker);
+
+	for (unsigned i = 0; i < total; i++) {
+		auto& s = ring[i % window];
+		s.ready.wait(false, std::memory_order_acquire);
+		emit(i, s.value);
+		s.ready.store(false, std::memory_order_relaxed);
+		emitted.store(i + 1, std::memory_order_release);
+		emitted.notify_all();
+	}
+	for (auto& t : threads)
+		t.join();
+}
+
+// If the user asked for "--threads 0" use every CPU we've got
+[[nodiscard]] static auto effective_num_threads(run_options const& opts) noexcept -> unsigned
+{
+	if (opts.num_threads != 0)
+		return opts.num_threads;
+	return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+static auto report_unsolvable(board_bitmask_t blockers) noexcept -> void
+{
+	fprintf(stderr, "Error: Couldn't solve board %09llX\n", static_cast<unsigned long long>(blockers));
+}
+
+// The part of the rolls, as a range of roll_from_index() indices, that
+// "--shard K/N" asks for.  Splitting the rolls into contiguous ranges this
+// way lets a big run be spread out over several machines, and because
+// the output comes out in roll order, putting the shards' outputs end to
+// end gives the same thing a single run would have (see merge_shards()).
+struct roll_range {
+	unsigned begin;
+	unsigned end;
+};
+
+[[nodiscard]] static auto shard_rolls(run_options const& opts) noexcept -> roll_range
+{
+	assert(opts.shard >= 1 and opts.shard <= opts.num_shards and opts.num_shards <= num_possible_rolls);
+	auto const boundary = [&opts](unsigned k) {
+		return static_cast<unsigned>(static_cast<std::uint64_t>(num_possible_rolls) * k / opts.num_shards);
+	};
+	return { boundary(opts.shard - 1), boundary(opts.shard) };
+}
+
+// The whole-space modes go through every roll of the dice, but (unless
+// use_symmetry is off) only search one board from each set that are the same
+// apart from rotation or reflection.  The boards to search are picked in
+// the order their first roll comes up, so the answer for each roll is
+// known as soon as every board up to its own has been searched.
+struct roll_symmetries {
+	// The canonical form of each board that needs to be searched, and
+	// the first roll that turns into it
+	std::vector<board_bitmask_t> representatives;
+	std::vector<unsigned> first_roll;
+	// For each roll in the range (starting from rolls.begin), which
+	// of the representatives it turns into and which symmetry does that
+	std::vector<unsigned> representative_of;
+	std::vector<std::uint8_t> symmetry_of;
+};
+
+[[nodiscard]] static auto find_roll_symmetries(bool use_symmetry, roll_range rolls) noexcept -> roll_symmetries
+{
+	roll_symmetries rv;
+	std::unordered_map<board_bitmask_t, unsigned> index_of;
+
+	rv.representative_of.resize(rolls.end - rolls.begin);
+	rv.symmetry_of.resize(rolls.end - rolls.begin);
+	for (auto i = rolls.begin; i < rolls.end; i++) {
+		auto const blockers = roll_from_index(i);
+		unsigned symmetry = 0;
+		auto const canonical = use_symmetry ? canonical_blockers(blockers, symmetry) : blockers;
+		auto const [it, inserted] = index_of.try_emplace(canonical, static_cast<unsigned>(rv.representatives.size()));
+		if (inserted) {
+			rv.representatives.push_back(canonical);
+			rv.first_roll.push_back(i);
+		}
+		rv.representative_of[i - rolls.begin] = it->second;
+		rv.symmetry_of[i - rolls.begin] = static_cast<std::uint8_t>(symmetry);
+	}
+	return rv;
+}
+
+// How many boards for_each_roll_by_symmetry() hands to compute() at a
+// time, so that the SIMD engine has plenty to work on at once
+static constexpr unsigned roll_chunk_size = 64;
+
+// Search the representative boards with compute(boards, results), which
+// gets them a chunk at a time and puts the result for each board in the
+// same position of 'results'.  That uses as many threads as 'opts' says.
+// Then call emit(blockers, symmetry, result) for every roll in order, where
+// 'result' is what compute() gave for the board that 'symmetry' turns it
+// into.  Only the rolls in this shard are covered, and only the boards
+// they need get searched.
+template<typename T, typename COMPUTE, typename EMIT>
+static auto for_each_roll_by_symmetry(run_options const& opts, COMPUTE const& compute, EMIT const& emit) noexcept -> void
+{
+	auto const rolls = shard_rolls(opts);
+	auto const sym = find_roll_symmetries(opts.use_symmetry, rolls);
+	auto const num_representatives = static_cast<unsigned>(sym.representatives.size());
+	auto const num_chunks = (num_representatives + roll_chunk_size - 1) / roll_chunk_size;
+	std::vector<T> results(num_representatives);
+
+	using chunk_results = std::array<T, roll_chunk_size>;
+	ordered_parallel_for<chunk_results>(effective_num_threads(opts), num_chunks,
+		[&](unsigned c) {
+			chunk_results chunk;
+			auto const first = c * roll_chunk_size;
+			auto const n = std::min(roll_chunk_size, num_representatives - first);
+			compute(std::span<board_bitmask_t const>(&sym.representatives[first], n), std::span<T>(chunk.data(), n));
+			return chunk;
+		},
+		[&](unsigned c, chunk_results const& chunk) {
+			auto const first = c * roll_chunk_size;
+			auto const n = std::min(roll_chunk_size, num_representatives - first);
+			std::copy_n(chunk.begin(), n, &results[first]);
+			// All of the rolls up to where the next chunk's first
+			// representative first shows up turn into ones we've
+			// searched by now
+			auto const next = first + n;
+			auto const end = (next < num_representatives) ? sym.first_roll[next] : rolls.end;
+			for (auto i = sym.first_roll[first]; i < end; i++) {
+				auto const j = i - rolls.begin;
+				assert(sym.representative_of[j] < next);
+				emit(roll_from_index(i), sym.symmetry_of[j], results[sym.representative_of[j]]);
+			}
+		});
+}
+
+// The same as for_each_roll_by_symmetry(), but for when nothing needs to
+// come out until the end.  The representatives get searched on the
+// work-stealing scheduler, so a chunk that takes a long time doesn't hold
+// up the threads behind it the way the reorder buffer would, and emit()
+// gets called for every roll once they're all done.
+template<typename T, typename COMPUTE, typename EMIT>
+static auto for_each_roll_by_symmetry_at_end(run_options const& opts, COMPUTE const& compute, EMIT const& emit) noexcept -> void
+{
+	auto const rolls = shard_rolls(opts);
+	auto const sym = find_roll_symmetries(opts.use_symmetry, rolls);
+	auto const num_representatives = static_cast<unsigned>(sym.representatives.size());
+	std::vector<T> results(num_representatives);
+
+	work_stealing_scheduler sched(effective_num_threads(opts));
+	sched.run(num_representatives, roll_chunk_size, [&](unsigned /* thread_index */, unsigned first, unsigned last) {
+		compute(std::span<board_bitmask_t const>(&sym.representatives[first], last - first),
+			std::span<T>(&results[first], last - first));
+	});
+	for (auto i = rolls.begin; i < rolls.end; i++) {
+		auto const j = i - rolls.begin;
+		emit(roll_from_index(i), sym.symmetry_of[j], results[sym.representative_of[j]]);
+	}
+}
+
+// Check that every roll of the dice can be solved.  Each solution found
+// gets turned back around to fit the roll it's for, which checks it
+// (when assertions are enabled).  Any failures are reported in roll order.
+[[maybe_unused]] [[nodiscard]] static auto verify_all_possible_rolls(run_options const& opts, shared_search_stats *stats) noexcept -> bool
+{
+	bool ok = true;
+	for_each_roll_by_symmetry_at_end<std::optional<placement_indices_t>>(opts,
+		[&opts, stats](std::span<board_bitmask_t const> boards, std::span<std::optional<placement_indices_t>> solutions) {
+			solve_boards(boards, solutions, opts.engine, stats);
+		},
+		[&opts, &ok](board_bitmask_t blockers, unsigned symmetry, std::optional<placement_indices_t> const& solution) {
+			assert(blockers_are_valid_roll(blockers));
+			if (not solution) {
+				[[unlikely]] report_unsolvable(blockers);
+				ok = false;
+				return;
+			}
+			board solved(transform_board(blockers, symmetry), opts.engine);
+			solved.set_placements(*solution);
+			board b(blockers, opts.engine);
+			b.set_transformed(solved, symmetry);
+		});
+	return ok;
+}
+
+// Precomputed answers for every possible roll of the dice, so we can
+// solve one without doing any searching at all.  The table is generated
+// by running "gsqsolve --emit-roll-table" (which works even in a build of
+// gsqsolve that doesn't have the table yet) and then compiled in by
+// building with -DGSQSOLVE_ROLL_TABLE.  The Makefile takes care of this.
+struct roll_table_entry {
+	std::uint16_t num_solutions;
+	// The first solution board::solve() finds using the loop nest, or
+	// all 0xFF if there isn't one
+	placement_indices_t solution;
+};
+
+// A hash of all of the placement arrays.  The table refers to placements
+// by their array index, so it's only usable if the arrays are the same
+// as they were when it was generated.
+[[nodiscard]] static auto consteval shape_fingerprint() noexcept -> std::uint64_t
+{
+	std::uint64_t hash = 0xCBF2'9CE4'8422'2325ull;		// FNV-1a
+	for (auto const piece : placed_pieces) {
+		for (auto const t : placements_of_piece[static_cast<unsigned>(piece)]) {
+			hash ^= t;
+			hash *= 0x100'0000'01B3ull;
+		}
+	}
+	return hash;
+}
+
+#ifdef GSQSOLVE_ROLL_TABLE
+#  include "roll_table.inc"
+static_assert(std::size(roll_table) == num_possible_rolls);
+#endif
+
+// Fill in the board using the precomputed roll table.  Returns false if
+// we don't have a table or 'blockers' isn't a valid roll.
+[[nodiscard]] static auto solve_from_roll_table([[maybe_unused]] board_bitmask_t blockers, [[maybe_unused]] board& b) noexcept -> bool
+{
+#ifdef GSQSOLVE_ROLL_TABLE
+	if (not blockers_are_valid_roll(blockers))
+		return false;
+	auto const& entry = roll_table[roll_index_of(blockers)];
+	if (entry.num_solutions == 0)
+		[[unlikely]] return false;
+	b.set_placements(entry.solution);
+	return true;
+#else
+	return false;
+#endif
+}
+
+[[nodiscard]] static auto make_roll_table_entry(unsigned idx, solver_engine engine) noexcept -> roll_table_entry
+{
+	auto const blockers = roll_from_index(idx);
+	roll_table_entry rv;
+
+	board counter(blockers, engine);
+	auto const count = counter.count_solutions();
+	assert(count <= UINT16_MAX);
+	rv.num_solutions = static_cast<std::uint16_t>(count);
+
+	board b(blockers, solver_engine::loop_nest);
+	if (b.solve())
+		rv.solution = b.placement_indices();
+	else
+		[[unlikely]] rv.solution.fill(0xFF);
+	return rv;
+}
+
+// Write out the source code for the roll table
+[[maybe_unused]] static auto emit_roll_table(run_options const& opts) noexcept -> void
+{
+	printf(	"// Generated by \"gsqsolve --emit-roll-table\" -- do not edit\n"
+		"static_assert(shape_fingerprint() == 0x%016llXull, \"roll_table.inc is out of date\");\n"
+		"static constexpr roll_table_entry roll_table[] = {\n",
+		static_cast<unsigned long long>(shape_fingerprint()));
+	ordered_parallel_for<roll_table_entry>(effective_num_threads(opts), num_possible_rolls,
+		[&opts](unsigned i) {
+			return make_roll_table_entry(i, opts.engine);
+		},
+		[](unsigned /* i */, roll_table_entry const& e) {
+			printf("\t{ %u, {", e.num_solutions);
+			for (auto const p : e.solution)
+				printf(" %u,", p);
+			puts(" } },");
+		});
+	puts("};");
+}
+
+static auto print_solution_count(board_bitmask_t blockers, unsigned count) noexcept -> void
+{
+	printf("%u\t", count);
+	char const *before = "";
+	for (unsigned row = 0; row < 6; row++) {
+		for (unsigned col = 0; col < 6; col++) {
+			if ((sbit(row, col) & blockers) != 0) {
+				printf("%s%c%u", before, 'A' + row, col + 1);
+				before = " ";
+			}
+		}
+	}
+	putchar('\n');
+}
+
+// How big a memo_table to share between all of the boards that
+// "--solution-counts" searches.  Each entry takes 8 bytes.
+static constexpr unsigned shared_memo_log2_entries = 23;
+
+[[maybe_unused]] static auto count_solutions_of_every_board_position(run_options const& opts, shared_search_stats *stats) noexcept -> void
+{
+	// The memo engine can reuse answers from one board on another
+	std::optional<memo_table> memo;
+	if (opts.engine == solver_engine::memo)
+		memo.emplace(shared_memo_log2_entries);
+
+	for_each_roll_by_symmetry<unsigned>(opts,
+		[&opts, stats, &memo](std::span<board_bitmask_t const> boards, std::span<unsigned> counts) {
+			for (std::size_t i = 0; i < boards.size(); i++) {
+				board b(boards[i], opts.engine, memo ? &*memo : nullptr);
+				counts[i] = search_maybe_with_stats(stats, [&b](auto& s) { return b.count_solutions(s); });
+			}
+		},
+		[](board_bitmask_t blockers, unsigned /* symmetry */, unsigned count) {
+			print_solution_count(blockers, count);
+		});
+}
+
+// "--tiling-counts": rather than searching each board separately, go
+// through every way of putting all of the placed_pieces down on an empty
+// board without any of them overlapping.  That always leaves 8 squares
+// empty, and picking any 7 of those as the blockers (with the single square
+// going on the 8th) gives a board that this layout solves.  So once we know
+// how many layouts leave each set of 8 squares empty, we know how many
+// solutions every possible board has.
+//
+// There are about 1.4 billion layouts, so this takes a while, but it's
+// the same amount of work no matter how many boards we want counts for.
+// Symmetry (see canonical_blockers()) cuts it down a lot: turning a layout
+// around gives another layout, with its empty squares turned the same way.
+// So we only need to go through the layouts where the first piece is in
+// one position out of each set that are rotations or reflections of each
+// other, count each of those as many times as there are positions in the
+// set, and only keep track of the canonical form of the empty squares.
+
+// The last piece gets placed with bit operations instead of a loop (see
+// tiling_counts::place_), which is only right if its placements are just
+// every pair of neighboring squares
+[[nodiscard]] static auto consteval line2_is_every_neighboring_pair() noexcept -> bool
+{
+	if (placed_pieces.back() != piece_id::line2 or std::size(line2) != 60)
+		return false;
+	for (auto const t : line2) {
+		auto const low = t & -t;
+		if (t != (low | (low << 1)) and t != (low | (low << 6)))
+			return false;
+		if ((low & last_column) != 0 and t == (low | (low << 1)))
+			return false;
+	}
+	return true;
+}
+static_assert(line2_is_every_neighboring_pair());
+
+class tiling_counts {
+    public:
+	tiling_counts() noexcept
+		: layouts_(binomial[36][8])
+	{
+	}
+
+	// Go through every layout, spread over 'num_threads' threads
+	auto count_layouts(unsigned num_threads) noexcept -> void
+	{
+		// The positions of the first piece that we start from, and how
+		// many positions each of them stands for
+		std::vector<std::pair<board_bitmask_t, unsigned>> starts;
+		for (auto const t : placements_of_piece[static_cast<unsigned>(placed_pieces[0])]) {
+			unsigned symmetry;
+			if (canonical_blockers(t, symmetry) != t)
+				continue;
+			std::array<board_bitmask_t, num_symmetries> images;
+			for (unsigned k = 0; k < num_symmetries; k++)
+				images[k] = transform_board(t, k);
+			std::sort(images.begin(), images.end());
+			starts.emplace_back(t, static_cast<unsigned>(std::unique(images.begin(), images.end()) - images.begin()));
+		}
+
+		// Hand out work by where the first two pieces go
+		auto const second = placements_of_piece[static_cast<unsigned>(placed_pieces[1])];
+		auto const num_second = static_cast<unsigned>(second.size());
+		work_stealing_scheduler sched(num_threads);
+		sched.run(static_cast<unsigned>(starts.size()) * num_second, 1, [&](unsigned /* thread_index */, unsigned first, unsigned last) {
+			for (auto i = first; i < last; i++) {
+				auto const [t0, weight] = starts[i / num_second];
+				auto const t1 = second[i % num_second];
+				if ((t0 & t1) != 0)
+					continue;
+				if (num_threads > 1)
+					place_<2, true>(t0 | t1, weight);
+				else
+					place_<2, false>(t0 | t1, weight);
+			}
+		});
+	}
+
+	// How many solutions the board with these blockers has
+	[[nodiscard]] auto solutions_for(board_bitmask_t blockers) const noexcept -> unsigned
+	{
+		assert(std::popcount(blockers) == 7);
+		std::uint64_t total = 0;
+		for (auto empty = all_squares & ~blockers; empty != 0; empty &= empty - 1)
+			total += layouts_leaving_(blockers | (empty & -empty));
+		assert(total <= UINT32_MAX);
+		return static_cast<unsigned>(total);
+	}
+
+    private:
+	// Indexed by the rank_of_squares() of a canonical set of 8 empty
+	// squares, how many layouts leave that set, or any rotation or
+	// reflection of it, empty
+	std::vector<std::uint32_t> layouts_;
+
+	// How many layouts leave exactly 'empty' empty
+	[[nodiscard]] auto layouts_leaving_(board_bitmask_t empty) const noexcept -> std::uint32_t
+	{
+		unsigned symmetry;
+		auto const canonical = canonical_blockers(empty, symmetry);
+		// The layouts for the other sets of squares in the same
+		// group all got added together, and each of those has as
+		// many layouts as this one.  How many there are in the group
+		// depends on how many symmetries leave the set unchanged.
+		unsigned unchanged = 0;
+		for (unsigned k = 0; k < num_symmetries; k++)
+			if (transform_board(canonical, k) == canonical)
+				unchanged++;
+		auto const group_size = num_symmetries / unchanged;
+		auto const total = layouts_[rank_of_squares(canonical)];
+		assert(total % group_size == 0);
+		return total / group_size;
+	}
+
+	template<unsigned LEVEL, bool ATOMIC>
+	auto place_(board_bitmask_t used, unsigned weight) noexcept -> void
+	{
+		if constexpr (LEVEL + 1 < placed_pieces.size()) {
+			for (auto const t : placements_of_piece[static_cast<unsigned>(placed_pieces[LEVEL])])
+				if ((t & used) == 0)
+					place_<LEVEL + 1, ATOMIC>(used | t, weight);
+		} else {
+			// Every pair of empty neighbors is somewhere the last
+			// piece could go; these are the left or top square of
+			// each of those pairs
+			auto const empty = all_squares & ~used;
+			auto const across = empty & (empty >> 1) & ~last_column;
+			auto const down = empty & (empty >> 6);
+			for (auto bits = across; bits != 0; bits &= bits - 1)
+				add_layout_<ATOMIC>(empty & ~((bits & -bits) * 0b11), weight);
+			for (auto bits = down; bits != 0; bits &= bits - 1)
+				add_layout_<ATOMIC>(empty & ~((bits & -bits) * 0b100'0001), weight);
+		}
+	}
+
+	template<bool ATOMIC>
+	auto add_layout_(board_bitmask_t empty, unsigned weight) noexcept -> void
+	{
+		unsigned symmetry;
+		auto& count = layouts_[rank_of_squares(canonical_blockers(empty, symmetry))];
+		if constexpr (ATOMIC)
+			std::atomic_ref<std::uint32_t>(count).fetch_add(weight, std::memory_order_relaxed);
+		else
+			count += weight;
+	}
+};
+
+// Print the count for every dice roll (the same as --solution-counts does)
+// or, if 'all_boards' is set, for every set of 7 blockers in the order of
+// rank_of_squares()
+[[maybe_unused]] static auto count_solutions_by_tiling(run_options const& opts, bool all_boards) noexcept -> void
+{
+	tiling_counts tc;
+	tc.count_layouts(effective_num_threads(opts));
+	if (not all_boards) {
+		for (unsigned i = 0; i < num_possible_rolls; i++) {
+			auto const blockers = roll_from_index(i);
+			print_solution_count(blockers, tc.solutions_for(blockers));
+		}
+		return;
+	}
+	auto blockers = (static_cast<board_bitmask_t>(1) << 7) - 1;
+	for (std::uint32_t i = 0; i < binomial[36][7]; i++) {
+		assert(rank_of_squares(blockers) == i);
+		print_solution_count(blockers, tc.solutions_for(blockers));
+		blockers = next_set_of_squares(blockers);
+	}
+}
+
+// A whole file mapped into memory.  Errors get reported to stderr.
+class mapped_file {
+    public:
+	mapped_file() noexcept = default;
+	mapped_file(mapped_file const&) = delete;
+	auto operator=(mapped_file const&) -> mapped_file& = delete;
+
+	~mapped_file()
+	{
+		if (data_ != nullptr)
+			munmap(data_, size_);
+	}
+
+	// Map an existing file, read-only
+	[[nodiscard]] auto open(char const *path) noexcept -> bool
+	{
+		auto const fd = ::open(path, O_RDONLY | O_CLOEXEC);
+		if (fd < 0) {
+			[[unlikely]] fprintf(stderr, "Error: %s: %s\n", path, strerror(errno));
+			return false;
+		}
+		struct stat st;
+		auto const ok = fstat(fd, &st) == 0 and map_(fd, static_cast<std::size_t>(st.st_size), PROT_READ);
+		if (not ok)
+			[[unlikely]] fprintf(stderr, "Error: %s: %s\n", path, strerror(errno));
+		close(fd);
+		return ok;
+	}
+
+	// Create (or replace) a file of 'size' bytes and map it writable.
+	// The space gets allocated up front so that running out of disk
+	// is an error here rather than a SIGBUS later.
+	[[nodiscard]] auto create(char const *path, std::size_t size) noexcept -> bool
+	{
+		auto const fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+		if (fd < 0) {
+			[[unlikely]] fprintf(stderr, "Error: %s: %s\n", path, strerror(errno));
+			return false;
+		}
+		if (auto const err = posix_fallocate(fd, 0, static_cast<off_t>(size)); err != 0) {
+			[[unlikely]] fprintf(stderr, "Error: %s: %s\n", path, strerror(err));
+			close(fd);
+			return false;
+		}
+		auto const ok = map_(fd, size, PROT_READ | PROT_WRITE);
+		if (not ok)
+			[[unlikely]] fprintf(stderr, "Error: %s: %s\n", path, strerror(errno));
+		close(fd);
+		return ok;
+	}
+
+	// Write everything out to the disk, so that the file is complete
+	// before it gets renamed into place
+	[[nodiscard]] auto sync() const noexcept -> bool
+	{
+		return msync(data_, size_, MS_SYNC) == 0;
+	}
+
+	[[nodiscard]] auto data() const noexcept -> std::byte *
+	{
+		return static_cast<std::byte *>(data_);
+	}
+
+	[[nodiscard]] auto size() const noexcept -> std::size_t
+	{
+		return size_;
+	}
+
+    private:
+	void *data_ = nullptr;
+	std::size_t size_ = 0;
+
+	[[nodiscard]] auto map_(int fd, std::size_t size, int prot) noexcept -> bool
+	{
+		if (size == 0) {
+			[[unlikely]] errno = EINVAL;
+			return false;
+		}
+		auto const p = mmap(nullptr, size, prot, MAP_SHARED, fd, 0);
+		if (p == MAP_FAILED)
+			[[unlikely]] return false;
+		data_ = p;
+		size_ = size;
+		return true;
+	}
+};
+
+// "--census <file>": work out whether every possible set of 7 blockers
+// can be solved, and how many solutions it has, and save that in a file
+// that can be mapped straight into memory to look boards up.  The file is
+// a census_header followed by two arrays, each indexed by the board's
+// rank_of_squares(): a bitmap of which boards can be solved, and the
+// number of solutions of each one as a uint32_t.  Each array starts on a
+// page boundary.  Everything is in the machine's native byte order.
+struct census_header {
+	std::array<char, 8> magic;
+	std::uint32_t version;
+	std::uint32_t num_boards;
+	// shape_fingerprint() of the program that wrote it, so that it
+	// doesn't get used with different placement arrays
+	std::uint64_t fingerprint;
+	// Where in the file each of the arrays starts
+	std::uint64_t solvable_offset;
+	std::uint64_t counts_offset;
+};
+
+// Round a file offset up to the start of the next page
+[[nodiscard]] static constexpr auto page_align(std::size_t offset) noexcept -> std::size_t
+{
+	constexpr std::size_t page_size = 4096;
+	return (offset + page_size - 1) / page_size * page_size;
+}
+
+static constexpr std::array<char, 8> census_magic = { 'G', 'S', 'Q', 'C', 'E', 'N', 'S', '\0' };
+static constexpr std::uint32_t census_version = 1;
+static constexpr std::uint32_t census_num_boards = binomial[36][7];
+static constexpr std::size_t census_solvable_offset = page_align(sizeof(census_header));
+static constexpr std::size_t census_solvable_size = (census_num_boards + 63) / 64 * sizeof(std::uint64_t);
+static constexpr std::size_t census_counts_offset = page_align(census_solvable_offset + census_solvable_size);
+static constexpr std::size_t census_file_size = census_counts_offset + census_num_boards * sizeof(std::uint32_t);
+
+[[maybe_unused]] static auto write_census(run_options const& opts, char const *path) noexcept -> int
+{
+	auto const num_threads = effective_num_threads(opts);
+	tiling_counts tc;
+	tc.count_layouts(num_threads);
+
+	// Build it under another name and only rename it once it's all
+	// there, so that a run that gets interrupted can't leave behind
+	// something that looks like a census file but is mostly zeros
+	auto const tmp_path = std::string(path) + ".tmp";
+	mapped_file file;
+	if (not file.create(tmp_path.c_str(), census_file_size))
+		[[unlikely]] return EX_CANTCREAT;
+	auto const solvable = reinterpret_cast<std::uint64_t *>(file.data() + census_solvable_offset);
+	auto const counts = reinterpret_cast<std::uint32_t *>(file.data() + census_counts_offset);
+
+	// Each thread works on whole words of the bitmap so that none of
+	// them write to the same one
+	auto const num_words = (census_num_boards + 63) / 64;
+	work_stealing_scheduler sched(num_threads);
+	sched.run(num_words, 1024, [&](unsigned /* thread_index */, unsigned first, unsigned last) {
+		auto const first_rank = first * 64;
+		auto const last_rank = std::min(last * 64, census_num_boards);
+		auto blockers = squares_of_rank(first_rank, 7);
+		for (auto rank = first_rank; rank < last_rank; rank++) {
+			assert(rank_of_squares(blockers) == rank);
+			auto const count = tc.solutions_for(blockers);
+			counts[rank] = count;
+			if (count != 0)
+				solvable[rank / 64] |= static_cast<std::uint64_t>(1) << (rank % 64);
+			blockers = next_set_of_squares(blockers);
+		}
+	});
+
+	// The header goes in last, so that even the temporary file isn't
+	// valid until everything else is
+	census_header header {};
+	header.magic = census_magic;
+	header.version = census_version;
+	header.num_boards = census_num_boards;
+	header.fingerprint = shape_fingerprint();
+	header.solvable_offset = census_solvable_offset;
+	header.counts_offset = census_counts_offset;
+	memcpy(file.data(), &header, sizeof(header));
+	if (not file.sync() or rename(tmp_path.c_str(), path) != 0) {
+		[[unlikely]] fprintf(stderr, "Error: %s: %s\n", path, strerror(errno));
+		unlink(tmp_path.c_str());
+		return EX_IOERR;
+	}
+	return EX_OK;
+}
+
+// A file written by "--census", for looking up any board
+class census_file {
+    public:
+	[[nodiscard]] auto open(char const *path) noexcept -> bool
+	{
+		if (not file_.open(path))
+			[[unlikely]] return false;
+		census_header header;
+		if (file_.size() != census_file_size) {
+			[[unlikely]] fprintf(stderr, "Error: %s: Not a census file\n", path);
+			return false;
+		}
+		memcpy(&header, file_.data(), sizeof(header));
+		if (header.magic != census_magic or header.version != census_version or
+		    header.num_boards != census_num_boards or
+		    header.solvable_offset != census_solvable_offset or header.counts_offset != census_counts_offset) {
+			[[unlikely]] fprintf(stderr, "Error: %s: Not a census file\n", path);
+			return false;
+		}
+		if (header.fingerprint != shape_fingerprint()) {
+			[[unlikely]] fprintf(stderr, "Error: %s: Census file is out of date\n", path);
+			return false;
+		}
+		solvable_ = reinterpret_cast<std::uint64_t const *>(file_.data() + census_solvable_offset);
+		counts_ = reinterpret_cast<std::uint32_t const *>(file_.data() + census_counts_offset);
+		return true;
+	}
+
+	[[nodiscard]] auto is_solvable(board_bitmask_t blockers) const noexcept -> bool
+	{
+		auto const rank = rank_of_squares(blockers);
+		return ((solvable_[rank / 64] >> (rank % 64)) & 1) != 0;
+	}
+
+	[[nodiscard]] auto solution_count(board_bitmask_t blockers) const noexcept -> unsigned
+	{
+		return counts_[rank_of_squares(blockers)];
+	}
+
+    private:
+	mapped_file file_;
+	std::uint64_t const *solvable_ = nullptr;
+	std::uint32_t const *counts_ = nullptr;
+};
+
+// "--build-db <file>": save the same answers that are in the roll table in
+// a file instead.  A program can then map that into memory and answer any
+// roll without searching, and any number of them can share one copy of it
+// in the page cache.  The file is a roll_db_header followed by two arrays,
+// each indexed by roll_index_of() and starting on a page boundary: the
+// number of solutions of each roll as a uint32_t, and then the first
+// solution the loop nest finds, as its placement_indices() (all 0xFF if
+// there isn't one).  Everything is in the machine's native byte order.
+struct roll_db_header {
+	std::array<char, 8> magic;
+	std::uint32_t version;
+	std::uint32_t num_rolls;
+	// shape_fingerprint() of the program that wrote it, since the
+	// solutions are indices into the placement arrays
+	std::uint64_t fingerprint;
+	// Where in the file each of the arrays starts
+	std::uint64_t counts_offset;
+	std::uint64_t solutions_offset;
+};
+
+static constexpr std::array<char, 8> roll_db_magic = { 'G', 'S', 'Q', 'R', 'O', 'L', 'L', '\0' };
+static constexpr std::uint32_t roll_db_version = 1;
+static constexpr std::size_t roll_db_counts_offset = page_align(sizeof(roll_db_header));
+static constexpr std::size_t roll_db_solutions_offset = page_align(roll_db_counts_offset + num_possible_rolls * sizeof(std::uint32_t));
+static constexpr std::size_t roll_db_file_size = roll_db_solutions_offset + num_possible_rolls * sizeof(placement_indices_t);
+
+[[maybe_unused]] static auto write_roll_db(run_options const& opts, char const *path) noexcept -> int
+{
+	// Build it under another name and rename it over the old one at the
+	// end, the same as write_census().  Programs that have the old one
+	// mapped keep using it rather than having it truncated under them,
+	// and an interrupted run can't leave a half-written database.
+	auto const tmp_path = std::string(path) + ".tmp";
+	mapped_file file;
+	if (not file.create(tmp_path.c_str(), roll_db_file_size))
+		[[unlikely]] return EX_CANTCREAT;
+	auto const counts = reinterpret_cast<std::uint32_t *>(file.data() + roll_db_counts_offset);
+	auto const solutions = reinterpret_cast<placement_indices_t *>(file.data() + roll_db_solutions_offset);
+
+	ordered_parallel_for<roll_table_entry>(effective_num_threads(opts), num_possible_rolls,
+		[&opts](unsigned i) {
+			return make_roll_table_entry(i, opts.engine);
+		},
+		[counts, solutions](unsigned i, roll_table_entry const& e) {
+			counts[i] = e.num_solutions;
+			solutions[i] = e.solution;
+		});
+
+	roll_db_header header {};
+	header.magic = roll_db_magic;
+	header.version = roll_db_version;
+	header.num_rolls = num_possible_rolls;
+	header.fingerprint = shape_fingerprint();
+	header.counts_offset = roll_db_counts_offset;
+	header.solutions_offset = roll_db_solutions_offset;
+	memcpy(file.data(), &header, sizeof(header));
+	if (not file.sync() or rename(tmp_path.c_str(), path) != 0) {
+		[[unlikely]] fprintf(stderr, "Error: %s: %s\n", path, strerror(errno));
+		unlink(tmp_path.c_str());
+		return EX_IOERR;
+	}
+	return EX_OK;
+}
+
+// A file written by "--build-db", given with "--db"
+class roll_database {
+    public:
+	[[nodiscard]] auto open(char const *path) noexcept -> bool
+	{
+		if (not file_.open(path))
+			[[unlikely]] return false;
+		roll_db_header header;
+		if (file_.size() != roll_db_file_size) {
+			[[unlikely]] fprintf(stderr, "Error: %s: Not a gsqsolve database\n", path);
+			return false;
+		}
+		memcpy(&header, file_.data(), sizeof(header));
+		if (header.magic != roll_db_magic or header.version != roll_db_version or
+		    header.num_rolls != num_possible_rolls or
+		    header.counts_offset != roll_db_counts_offset or header.solutions_offset != roll_db_solutions_offset) {
+			[[unlikely]] fprintf(stderr, "Error: %s: Not a gsqsolve database\n", path);
+			return false;
+		}
+		if (header.fingerprint != shape_fingerprint()) {
+			[[unlikely]] fprintf(stderr, "Error: %s: Database is out of date\n", path);
+			return false;
+		}
+		counts_ = reinterpret_cast<std::uint32_t const *>(file_.data() + roll_db_counts_offset);
+		solutions_ = reinterpret_cast<placement_indices_t const *>(file_.data() + roll_db_solutions_offset);
+		return true;
+	}
+
+	// Fill in the board with the saved solution.  Returns false if
+	// 'blockers' isn't a valid roll or doesn't have a solution.
+	[[nodiscard]] auto solve(board_bitmask_t blockers, board& b) const noexcept -> bool
+	{
+		if (not blockers_are_valid_roll(blockers))
+			return false;
+		auto const idx = roll_index_of(blockers);
+		if (counts_[idx] == 0)
+			[[unlikely]] return false;
+		b.set_placements(solutions_[idx]);
+		return true;
+	}
+
+    private:
+	mapped_file file_;
+	std::uint32_t const *counts_ = nullptr;
+	placement_indices_t const *solutions_ = nullptr;
+};
+
+// Fill in the board from the answers we worked out ahead of time, if we
+// have one for it: from the database given with "--db" if there is one,
+// otherwise from the roll table
+[[nodiscard]] static auto solve_without_searching(board_bitmask_t blockers, board& b, run_options const& opts) noexcept -> bool
+{
+	if (not opts.use_roll_table)
+		return false;
+	if (opts.db != nullptr)
+		return opts.db->solve(blockers, b);
+	return solve_from_roll_table(blockers, b);
+}
+
+// Parse a line listing the seven board positions separated by whitespace,
+// the same way they'd be given on the command line.  Returns nullptr on
+// success, otherwise a description of what was wrong with it.
+[[nodiscard]] static auto parse_blocker_line(std::string_view line, board_bitmask_t& blockers) noexcept -> char const *
+{
+	auto const is_space = [](char c) { return c == ' ' or c == '\t' or c == '\r'; };
+	unsigned num_positions = 0;
+
+	blockers = 0;
+	for (std::size_t i = 0;;) {
+		while (i < line.size() and is_space(line[i]))
+			i++;
+		if (i >= line.size())
+			break;
+		auto const start = i;
+		while (i < line.size() and not is_space(line[i]))
+			i++;
+		if (i - start != 2)
+			[[unlikely]] return "Bad board position";
+		std::array<char, 3> const id = { line[start], line[start + 1], '\0' };
+		auto const b = sbit(id.data());
+		if (b == 0)
+			[[unlikely]] return "Bad board position";
+		if ((blockers & b) != 0)
+			[[unlikely]] return "Board position listed multiple times";
+		blockers |= b;
+		num_positions++;
+	}
+	if (num_positions != 7)
+		[[unlikely]] return "Expected 7 board positions";
+	return nullptr;
+}
+
+// Solve the board described by one line of input and append the answer
+// to 'reply'.  In the "ansi" format each reply ends with a blank line so
+// that a reader can tell where one board stops and the next one starts;
+// the "compact" and "ndjson" formats are always exactly one line, and
+// "bin" is always bin_record_size bytes.
+enum class request_result {
+	solved,
+	no_solution,
+	bad_request,
+};
+
+// Append the reply for a line that couldn't be parsed
+static auto append_error_reply(char const *error, run_options const& opts, std::string& reply) noexcept -> request_result
+{
+	switch (opts.format) {
+	    case output_format::bin:
+		reply.append(bin_record_size, static_cast<char>(no_solution_index));
+		break;
+	    case output_format::ndjson:
+		// None of the errors need any escaping
+		reply += "{\"error\":\"";
+		reply += error;
+		reply += "\"}\n";
+		break;
+	    case output_format::ansi:
+		reply += "Error: ";
+		reply += error;
+		reply += "\n\n";
+		break;
+	    case output_format::compact:
+		reply += "Error: ";
+		reply += error;
+		reply += '\n';
+		break;
+	}
+	return request_result::bad_request;
+}
+
+// Append the reply for a board, or for one with no solution if 'solved'
+// is null
+static auto append_board_reply(board_bitmask_t blockers, board const *solved, run_options const& opts, std::string& reply) noexcept -> request_result
+{
+	auto result = request_result::solved;
+	if (solved != nullptr) {
+		solved->render(reply, opts.format);
+	} else {
+		[[unlikely]] render_no_solution(blockers, opts.format, reply);
+		result = request_result::no_solution;
+	}
+	if (opts.format == output_format::ansi)
+		reply += '\n';
+	return result;
+}
+
+static auto solve_request(std::string_view line, run_options const& opts, std::string& reply) noexcept -> request_result
+{
+	board_bitmask_t blockers;
+	if (auto const error = parse_blocker_line(line, blockers); error != nullptr)
+		[[unlikely]] return append_error_reply(error, opts, reply);
+	board b(blockers, opts.engine);
+	auto const solved = solve_without_searching(blockers, b, opts) or b.solve();
+	return append_board_reply(blockers, solved ? &b : nullptr, opts, reply);
+}
+
+// solve_request() for several lines at once.  The boards that need
+// searching all get handed to solve_boards() together, so that the SIMD
+// engine can work on them at the same time.
+static auto solve_requests(std::span<std::string_view const> lines, run_options const& opts,
+			   std::span<std::string> replies, std::span<request_result> results) noexcept -> void
+{
+	std::vector<board_bitmask_t> to_search;
+	std::vector<std::size_t> searched_line;
+	for (std::size_t i = 0; i < lines.size(); i++) {
+		replies[i].clear();
+		board_bitmask_t blockers;
+		if (auto const error = parse_blocker_line(lines[i], blockers); error != nullptr) {
+			[[unlikely]] results[i] = append_error_reply(error, opts, replies[i]);
+			continue;
+		}
+		board b(blockers, opts.engine);
+		if (solve_without_searching(blockers, b, opts)) {
+			results[i] = append_board_reply(blockers, &b, opts, replies[i]);
+			continue;
+		}
+		to_search.push_back(blockers);
+		searched_line.push_back(i);
+	}
+
+	std::vector<std::optional<placement_indices_t>> solutions(to_search.size());
+	solve_boards(to_search, solutions, opts.engine, nullptr);
+	for (std::size_t j = 0; j < to_search.size(); j++) {
+		auto const i = searched_line[j];
+		board b(to_search[j], opts.engine);
+		if (solutions[j])
+			b.set_placements(*solutions[j]);
+		results[i] = append_board_reply(to_search[j], solutions[j] ? &b : nullptr, opts, replies[i]);
+	}
+}
+
+// "--batch": read boards from stdin, one per line, and write the replies
+// from solve_request() to stdout in the same order.  Input is read and
+// processed a batch of lines at a time.  The boards in a batch get solved
+// (on several threads, if asked to) into a reusable set of buffers, and
+// then the replies for the whole batch go out with a single write.
+//
+// Returns EX_DATAERR if any line couldn't be parsed, otherwise 1 if any
+// board had no solution.
+[[maybe_unused]] [[nodiscard]] static auto solve_batch(run_options const& opts) noexcept -> int
+{
+	static constexpr std::size_t lines_per_batch = 16384;
+	static constexpr std::size_t read_size = 1 << 20;
+	auto const num_threads = effective_num_threads(opts);
+
+	std::string input;
+	// Where each line starts and how long it is.  These are offsets rather
+	// than string_views since 'input' may move as we read more into it.
+	std::vector<std::pair<std::size_t, std::size_t>> lines;
+	std::vector<std::string> replies(lines_per_batch);
+	std::vector<request_result> results(lines_per_batch);
+	std::string output;
+	bool at_eof = false;
+	bool saw_bad_request = false;
+	bool saw_no_solution = false;
+
+	lines.reserve(lines_per_batch);
+	while (not at_eof or not input.empty()) {
+		// Make sure we have a full batch of lines, or all that's left
+		std::size_t consumed = 0;
+		lines.clear();
+		for (;;) {
+			auto const end = input.find('\n', consumed);
+			if (end == std::string::npos) {
+				if (not at_eof) {
+					auto const old_size = input.size();
+					input.resize(old_size + read_size);
+					auto const n = fread(input.data() + old_size, 1, read_size, stdin);
+					input.resize(old_size + n);
+					if (n == 0)
+						at_eof = true;
+					continue;
+				}
+				// A final line with no newline at the end
+				if (consumed < input.size())
+					lines.emplace_back(consumed, input.size() - consumed);
+				consumed = input.size();
+				break;
+			}
+			auto const line = std::string_view(input).substr(consumed, end - consumed);
+			if (line.find_first_not_of(" \t\r") != std::string_view::npos)
+				lines.emplace_back(consumed, line.size());
+			consumed = end + 1;
+			if (lines.size() >= lines_per_batch)
+				break;
+		}
+
+		auto const solve_lines = [&](unsigned first, unsigned last) {
+			std::vector<std::string_view> views;
+			views.reserve(last - first);
+			for (auto i = first; i < last; i++)
+				views.push_back(std::string_view(input).substr(lines[i].first, lines[i].second));
+			solve_requests(views, opts, std::span(replies).subspan(first, last - first),
+				       std::span(results).subspan(first, last - first));
+		};
+		auto const n = static_cast<unsigned>(lines.size());
+		if (num_threads > 1 and n > 1) {
+			work_stealing_scheduler sched(num_threads);
+			sched.run(n, 64, [&](unsigned /* thread_index */, unsigned first, unsigned last) {
+				solve_lines(first, last);
+			});
+		} else {
+			solve_lines(0, n);
+		}
+
+		output.clear();
+		for (unsigned i = 0; i < n; i++) {
+			output += replies[i];
+			saw_bad_request |= (results[i] == request_result::bad_request);
+			saw_no_solution |= (results[i] == request_result::no_solution);
+		}
+		if (fwrite(output.data(), 1, output.size(), stdout) != output.size()) {
+			[[unlikely]] fprintf(stderr, "Error: Couldn't write output: %s\n", strerror(errno));
+			return EX_IOERR;
+		}
+		input.erase(0, consumed);
+	}
+	if (fflush(stdout) != 0) {
+		[[unlikely]] fprintf(stderr, "Error: Couldn't write output: %s\n", strerror(errno));
+		return EX_IOERR;
+	}
+	if (saw_bad_request)
+		return EX_DATAERR;
+	return saw_no_solution ? 1 : EX_OK;
+}
+
+// "--merge": put the outputs of "--solution-counts --shard K/N" back
+// together.  Each file has to be a run of consecutive rolls, in order and
+// with nothing missing, and between them the files have to cover every
+// roll exactly once.  They can be listed in any order; what gets written
+// out is the same as one run over every roll would have printed.
+[[maybe_unused]] [[nodiscard]] static auto merge_shards(std::span<char const * const> paths) noexcept -> int
+{
+	struct shard_file {
+		char const *path;
+		mapped_file file;
+		roll_range rolls;
+	};
+	std::vector<shard_file> shards(paths.size());
+
+	// Check one line of a file, returning what's wrong with it if
+	// anything.  Each line is the count, a tab, and the roll.
+	auto const check_line = [](std::string_view line, unsigned line_num, roll_range& rolls) -> char const * {
+		auto const tab = line.find('\t');
+		if (tab == 0 or tab == std::string_view::npos or
+		    line.substr(0, tab).find_first_not_of("0123456789") != std::string_view::npos)
+			[[unlikely]] return "Expected a solution count";
+		board_bitmask_t blockers;
+		if (auto const error = parse_blocker_line(line.substr(tab + 1), blockers); error != nullptr)
+			[[unlikely]] return error;
+		if (not blockers_are_valid_roll(blockers))
+			[[unlikely]] return "Not a valid dice roll";
+		auto const idx = roll_index_of(blockers);
+		if (line_num == 0)
+			rolls.begin = idx;
+		else if (idx != rolls.begin + line_num)
+			[[unlikely]] return "Rolls are out of order";
+		return nullptr;
+	};
+
+	for (std::size_t f = 0; f < paths.size(); f++) {
+		auto& s = shards[f];
+		s.path = paths[f];
+		if (not s.file.open(s.path))
+			[[unlikely]] return EX_NOINPUT;
+		std::string_view const text(reinterpret_cast<char const *>(s.file.data()), s.file.size());
+		if (text.back() != '\n') {
+			[[unlikely]] fprintf(stderr, "Error: %s: Last line is incomplete\n", s.path);
+			return EX_DATAERR;
+		}
+		unsigned line_num = 0;
+		for (std::size_t pos = 0; pos < text.size(); line_num++) {
+			auto const end = text.find('\n', pos);
+			auto const line = text.substr(pos, end - pos);
+			pos = end + 1;
+			if (auto const error = check_line(line, line_num, s.rolls); error != nullptr) {
+				[[unlikely]] fprintf(stderr, "Error: %s:%u: %s\n", s.path, line_num + 1, error);
+				return EX_DATAERR;
+			}
+		}
+		s.rolls.end = s.rolls.begin + line_num;
+	}
+
+	// mapped_file can't be moved, so sort pointers to them instead
+	std::vector<shard_file const *> in_order;
+	for (auto const& s : shards)
+		in_order.push_back(&s);
+	std::sort(in_order.begin(), in_order.end(), [](shard_file const *a, shard_file const *b) {
+		return a->rolls.begin < b->rolls.begin;
+	});
+	unsigned next_roll = 0;
+	for (auto const s : in_order) {
+		if (s->rolls.begin != next_roll) {
+			[[unlikely]] fprintf(stderr, "Error: %s: Starts at roll %u, but roll %u was expected\n",
+					     s->path, s->rolls.begin, next_roll);
+			return EX_DATAERR;
+		}
+		next_roll = s->rolls.end;
+	}
+	if (next_roll != num_possible_rolls) {
+		[[unlikely]] fprintf(stderr, "Error: Only rolls up to %u are covered, not all %u\n", next_roll, num_possible_rolls);
+		return EX_DATAERR;
+	}
+
+	for (auto const s : in_order) {
+		if (fwrite(s->file.data(), 1, s->file.size(), stdout) != s->file.size()) {
+			[[unlikely]] fprintf(stderr, "Error: Couldn't write output: %s\n", strerror(errno));
+			return EX_IOERR;
+		}
+	}
+	if (fflush(stdout) != 0) {
+		[[unlikely]] fprintf(stderr, "Error: Couldn't write output: %s\n", strerror(errno));
+		return EX_IOERR;
+	}
+	return EX_OK;
+}
+
+// "--serve": a long-running process that answers requests sent over a Unix
+// domain socket.  Each request is one line listing seven board positions
+// and gets back the reply from solve_request().
+//
+// A single thread runs an epoll loop that does all of the socket I/O and
+// passes complete lines to a pool of worker threads, which hand their
+// replies back through a queue and wake the loop up with an eventfd.  Each
+// connection has at most one request with the workers at a time, so its
+// replies come back in the same order it sent the requests.
+class solve_server {
+    public:
+	explicit solve_server(run_options const& opts) noexcept
+		: opts_(opts)
+	{
+	}
+
+	~solve_server()
+	{
+		for (auto const& [fd, conn] : conns_)
+			close(fd);
+		for (auto const fd : { listen_fd_, epoll_fd_, wake_fd_, signal_fd_ })
+			if (fd >= 0)
+				close(fd);
+	}
+
+	// Serve requests until we get SIGINT or SIGTERM.  Returns an exit
+	// status for the program.
+	[[nodiscard]] auto run(char const *socket_path) noexcept -> int
+	{
+		if (not listen_(socket_path) or not setup_events_())
+			[[unlikely]] return EX_OSERR;
+
+		auto const num_workers = effective_num_threads(opts_);
+		std::vector<std::thread> workers;
+		workers.reserve(num_workers);
+		for (unsigned i = 0; i < num_workers; i++)
+			workers.emplace_back([this] { this->worker_(); });
+
+		event_loop_();
+
+		{
+			std::lock_guard<std::mutex> const guard(lock_);
+			stopping_ = true;
+		}
+		jobs_ready_.notify_all();
+		for (auto& t : workers)
+			t.join();
+		unlink(socket_path);
+		return EX_OK;
+	}
+
+    private:
+	// Longest request line we'll accept, and how much unsent output a
+	// connection can have before we stop working on its requests.  We
+	// also stop reading from a connection while it has that much output
+	// waiting or this many requests queued up, so a client that sends
+	// faster than it reads the replies can't use up all our memory.
+	static constexpr std::size_t max_line_length = 1024;
+	static constexpr std::size_t max_pending_output = 64 * 1024;
+	static constexpr std::size_t max_pending_requests = 1024;
+
+	struct connection {
+		// File descriptors get reused, so this tells replies for a
+		// closed connection apart from ones for its replacement
+		std::uint64_t id = 0;
+		std::string input;
+		std::string output;
+		std::deque<std::string> requests;
+		bool busy = false;		// a request is with the workers
+		bool read_closed = false;	// the client won't send any more
+		// What we've asked epoll to tell us about
+		std::uint32_t events = EPOLLIN | EPOLLRDHUP;
+	};
+
+	// Either a request going to the workers or a reply coming back
+	struct job {
+		int fd;
+		std::uint64_t conn_id;
+		std::string text;
+	};
+
+	run_options const opts_;
+	int listen_fd_ = -1;
+	int epoll_fd_ = -1;
+	int wake_fd_ = -1;
+	int signal_fd_ = -1;
+	std::unordered_map<int, connection> conns_;
+	std::uint64_t next_conn_id_ = 0;
+
+	std::mutex lock_;
+	std::condition_variable jobs_ready_;
+	std::deque<job> jobs_;
+	std::deque<job> replies_;
+	bool stopping_ = false;
+
+	static auto report_error_(char const *what) noexcept -> void
+	{
+		fprintf(stderr, "Error: %s: %s\n", what, strerror(errno));
+	}
+
+	[[nodiscard]] auto listen_(char const *socket_path) noexcept -> bool
+	{
+		sockaddr_un addr {};
+		addr.sun_family = AF_UNIX;
+		if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+			[[unlikely]] fprintf(stderr, "Error: Socket path too long: \"%s\"\n", socket_path);
+			return false;
+		}
+		strcpy(addr.sun_path, socket_path);
+
+		// Clean up after a previous server that didn't exit cleanly,
+		// but don't go deleting anything that isn't a socket
+		struct stat st;
+		if (lstat(socket_path, &st) == 0 and S_ISSOCK(st.st_mode))
+			unlink(socket_path);
+
+		listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if (listen_fd_ < 0) {
+			[[unlikely]] report_error_("socket");
+			return false;
+		}
+		if (bind(listen_fd_, reinterpret_cast<sockaddr const *>(&addr), sizeof(addr)) != 0) {
+			[[unlikely]] report_error_(socket_path);
+			return false;
+		}
+		if (listen(listen_fd_, SOMAXCONN) != 0) {
+			[[unlikely]] report_error_("listen");
+			return false;
+		}
+
+		// Each client needs a file descriptor, so allow as many as
+		// we're permitted to
+		struct rlimit rl;
+		if (getrlimit(RLIMIT_NOFILE, &rl) == 0 and rl.rlim_cur < rl.rlim_max) {
+			rl.rlim_cur = rl.rlim_max;
+			static_cast<void>(setrlimit(RLIMIT_NOFILE, &rl));
+		}
+		return true;
+	}
+
+	[[nodiscard]] auto setup_events_() noexcept -> bool
+	{
+		// Block SIGINT and SIGTERM before starting any threads so they
+		// all inherit that, and then pick them up via a signalfd instead
+		sigset_t signals;
+		sigemptyset(&signals);
+		sigaddset(&signals, SIGINT);
+		sigaddset(&signals, SIGTERM);
+		pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+		epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+		wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		signal_fd_ = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+		if (epoll_fd_ < 0 or wake_fd_ < 0 or signal_fd_ < 0) {
+			[[unlikely]] report_error_("epoll setup");
+			return false;
+		}
+		for (auto const fd : { listen_fd_, wake_fd_, signal_fd_ }) {
+			epoll_event ev {};
+			ev.events = EPOLLIN;
+			ev.data.fd = fd;
+			if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) != 0) {
+				[[unlikely]] report_error_("epoll_ctl");
+				return false;
+			}
+		}
+		return true;
+	}
+
+	auto event_loop_() noexcept -> void
+	{
+		std::array<epoll_event, 256> events;
+		for (;;) {
+			auto const n = epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()), -1);
+			if (n < 0) {
+				if (errno == EINTR)
+					continue;
+				[[unlikely]] report_error_("epoll_wait");
+				return;
+			}
+			for (int i = 0; i < n; i++) {
+				auto const fd = events[static_cast<unsigned>(i)].data.fd;
+				auto const what = events[static_cast<unsigned>(i)].events;
+				if (fd == signal_fd_)
+					return;
+				if (fd == listen_fd_)
+					accept_();
+				else if (fd == wake_fd_)
+					collect_replies_();
+				else
+					handle_client_(fd, what);
+			}
+		}
+	}
+
+	auto accept_() noexcept -> void
+	{
+		for (;;) {
+			auto const fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+			if (fd < 0) {
+				if (errno != EAGAIN and errno != EWOULDBLOCK and errno != EINTR and errno != ECONNABORTED)
+					[[unlikely]] report_error_("accept");
+				return;
+			}
+			epoll_event ev {};
+			ev.events = EPOLLIN | EPOLLRDHUP;
+			ev.data.fd = fd;
+			if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) != 0) {
+				[[unlikely]] report_error_("epoll_ctl");
+				close(fd);
+				continue;
+			}
+			conns_[fd].id = next_conn_id_++;
+		}
+	}
+
+	auto close_(int fd) noexcept -> void
+	{
+		// Closing the descriptor also takes it out of the epoll set.
+		// If a worker still has a request from it, the reply gets
+		// thrown away when it shows up since the id won't match.
+		close(fd);
+		conns_.erase(fd);
+	}
+
+	auto handle_client_(int fd, std::uint32_t what) noexcept -> void
+	{
+		auto const it = conns_.find(fd);
+		if (it == conns_.end())
+			[[unlikely]] return;
+		auto& conn = it->second;
+
+		if ((what & (EPOLLERR | EPOLLHUP)) != 0) {
+			[[unlikely]] close_(fd);
+			return;
+		}
+		if ((what & EPOLLOUT) != 0 and not flush_(fd, conn))
+			return;
+		if ((what & (EPOLLIN | EPOLLRDHUP)) != 0 and not read_(fd, conn))
+			return;
+		start_next_(fd, conn);
+		if (maybe_close_(fd, conn))
+			update_events_(fd, conn);
+	}
+
+	// Whether we want to read more requests from the connection yet
+	[[nodiscard]] static auto want_read_(connection const& conn) noexcept -> bool
+	{
+		return not conn.read_closed and conn.requests.size() < max_pending_requests and conn.output.size() < max_pending_output;
+	}
+
+	// Returns false if the connection got closed
+	[[nodiscard]] auto read_(int fd, connection& conn) noexcept -> bool
+	{
+		std::array<char, 4096> buf;
+		while (want_read_(conn)) {
+			auto const n = read(fd, buf.data(), buf.size());
+			if (n == 0) {
+				conn.read_closed = true;
+				break;
+			}
+			if (n < 0) {
+				if (errno == EINTR)
+					continue;
+				if (errno == EAGAIN or errno == EWOULDBLOCK)
+					break;
+				[[unlikely]] close_(fd);
+				return false;
+			}
+			conn.input.append(buf.data(), static_cast<std::size_t>(n));
+
+			std::size_t start = 0;
+			for (;;) {
+				auto const end = conn.input.find('\n', start);
+				if (end == std::string::npos)
+					break;
+				auto const line = std::string_view(conn.input).substr(start, end - start);
+				if (line.find_first_not_of(" \t\r") != std::string_view::npos)
+					conn.requests.emplace_back(line);
+				start = end + 1;
+			}
+			conn.input.erase(0, start);
+			if (conn.input.size() > max_line_length) {
+				[[unlikely]] close_(fd);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Write out as much pending output as the socket will take.
+	// Returns false if the connection got closed.
+	[[nodiscard]] auto flush_(int fd, connection& conn) noexcept -> bool
+	{
+		while (not conn.output.empty()) {
+			auto const n = send(fd, conn.output.data(), conn.output.size(), MSG_NOSIGNAL);
+			if (n >= 0) {
+				conn.output.erase(0, static_cast<std::size_t>(n));
+				continue;
+			}
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN or errno == EWOULDBLOCK)
+				break;
+			[[unlikely]] close_(fd);
+			return false;
+		}
+
+		return true;
+	}
+
+	// Only ask to hear about the socket being readable while we want
+	// more requests, and writable while we have something to write.
+	// Otherwise epoll would keep telling us about it, since it's level
+	// triggered: after the client shuts down its side, for instance,
+	// the socket stays readable forever.
+	auto update_events_(int fd, connection& conn) noexcept -> void
+	{
+		auto const events = (want_read_(conn) ? EPOLLIN | EPOLLRDHUP : 0u) | (conn.output.empty() ? 0u : EPOLLOUT);
+		if (events == conn.events)
+			return;
+		epoll_event ev {};
+		ev.events = events;
+		ev.data.fd = fd;
+		epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev);
+		conn.events = events;
+	}
+
+	// Hand the connection's next request to the workers, unless it
+	// already has one there or the client isn't keeping up with replies
+	auto start_next_(int fd, connection& conn) noexcept -> void
+	{
+		if (conn.busy or conn.requests.empty() or conn.output.size() >= max_pending_output)
+			return;
+		conn.busy = true;
+		{
+			std::lock_guard<std::mutex> const guard(lock_);
+			jobs_.push_back({ fd, conn.id, std::move(conn.requests.front()) });
+		}
+		conn.requests.pop_front();
+		jobs_ready_.notify_one();
+	}
+
+	// Once the client has hung up and we've answered everything it
+	// asked, we're done with the connection.  Returns false if closed.
+	auto maybe_close_(int fd, connection& conn) noexcept -> bool
+	{
+		if (conn.read_closed and not conn.busy and conn.requests.empty() and conn.output.empty()) {
+			close_(fd);
+			return false;
+		}
+		return true;
+	}
+
+	auto collect_replies_() noexcept -> void
+	{
+		std::uint64_t counter;
+		static_cast<void>(read(wake_fd_, &counter, sizeof(counter)));
+
+		std::deque<job> replies;
+		{
+			std::lock_guard<std::mutex> const guard(lock_);
+			replies.swap(replies_);
+		}
+		for (auto& r : replies) {
+			auto const it = conns_.find(r.fd);
+			if (it == conns_.end() or it->second.id != r.conn_id)
+				continue;
+			auto& conn = it->second;
+			conn.output += r.text;
+			conn.busy = false;
+			if (not flush_(r.fd, conn))
+				continue;
+			start_next_(r.fd, conn);
+			if (maybe_close_(r.fd, conn))
+				update_events_(r.fd, conn);
+		}
+	}
+
+	auto worker_() noexcept -> void
+	{
+		for (;;) {
+			job j;
+			{
+				std::unique_lock<std::mutex> lk(lock_);
+				jobs_ready_.wait(lk, [this] { return stopping_ or not jobs_.empty(); });
+				if (stopping_)
+					return;
+				j = std::move(jobs_.front());
+				jobs_.pop_front();
+			}
+			std::string reply;
+			static_cast<void>(solve_request(j.text, opts_, reply));
+			j.text = std::move(reply);
+			{
+				std::lock_guard<std::mutex> const guard(lock_);
+				replies_.push_back(std::move(j));
+			}
+			std::uint64_t const one = 1;
+			static_cast<void>(write(wake_fd_, &one, sizeof(one)));
+		}
+	}
+};
+
+[[maybe_unused]] static auto usage(FILE *fp) noexcept -> void
+{
+	fputs(	"Usage:\n"
+		"\t"	"gsqsolve <die_1> <die_2> ... <die_7>\n"
+		"\t"	"gsqsolve --random [count]\n"
+		"\t"	"gsqsolve --roll-index <n>\n"
+		"\t"	"gsqsolve --roll-index <die_1> <die_2> ... <die_7>\n"
+		"\t"	"gsqsolve --verify-all\n"
+		"\t"	"gsqsolve --solution-counts\n"
+		"\t"	"gsqsolve --merge <file>...\n"
+		"\t"	"gsqsolve --tiling-counts [all]\n"
+		"\t"	"gsqsolve --census <file>\n"
+		"\t"	"gsqsolve --build-db <file>\n"
+		"\t"	"gsqsolve --serve <socket-path>\n"
+		"\t"	"gsqsolve --batch < boards.txt\n"
+		"Options:\n"
+		"\t"	"--threads <n>\tthreads to use for --verify-all, --solution-counts,\n"
+		"\t\t"	"--tiling-counts, --census, --build-db, --serve and\n"
+		"\t\t"	"--batch (0 = one per CPU)\n"
+		"\t"	"--engine <name>\tsearch algorithm: \"loop-nest\" (the default),\n"
+		"\t\t"	"\"cell-driven\", \"dlx\", \"memo\", \"simd\" or \"narrowing\"\n"
+		"\t"	"--format <fmt>\thow to print solved boards: \"ansi\" (the default),\n"
+		"\t\t"	"\"compact\" (one line of 36 characters per board),\n"
+		"\t\t"	"\"bin\" (16 bytes per board) or \"ndjson\"\n"
+		"\t"	"--no-table\tsearch for a solution even if the board is a\n"
+		"\t\t"	"dice roll that we have a precomputed answer for\n"
+		"\t"	"--db <file>\tlook dice rolls up in a file written by\n"
+		"\t\t"	"--build-db instead of the built-in table\n"
+		"\t"	"--use-census <file>\n"
+		"\t\t"	"check boards that aren't dice rolls against a\n"
+		"\t\t"	"file written by --census\n"
+		"\t"	"--no-symmetry\tsearch every board for --verify-all and\n"
+		"\t\t"	"--solution-counts, including ones that are just\n"
+		"\t\t"	"another one rotated or flipped over\n"
+		"\t"	"--shard <k>/<n>\n"
+		"\t\t"	"only do the k'th of n equal parts of the rolls\n"
+		"\t\t"	"for --verify-all and --solution-counts\n"
+		"\t"	"--solutions <n>\tprint the first n solutions of a board instead\n"
+		"\t\t"	"of just one (0 = all of them), always searching\n"
+		"\t\t"	"with the loop nest\n"
+		"\t"	"--stats\t\tprint statistics about the search to stderr\n"
+		"\t\t"	"(implies --no-table)\n", fp);
+}
+
+[[nodiscard]] static auto parse_unsigned(char const *str, unsigned& out) noexcept -> bool
+{
+	if (str[0] < '0' or str[0] > '9')
+		return false;
+	char *end;
+	auto const v = strtoul(str, &end, 10);
+	if (*end != '\0' or v > UINT32_MAX)
+		return false;
+	out = static_cast<unsigned>(v);
+	return true;
+}
+
+[[nodiscard]] static auto parse_engine(char const *str, solver_engine& out) noexcept -> bool
+{
+	for (auto const& e : engine_names) {
+		if (0 == strcmp(str, e.name)) {
+			out = e.engine;
+			return true;
+		}
+	}
+	return false;
+}
+
+[[nodiscard]] static auto parse_format(char const *str, output_format& out) noexcept -> bool
+{
+	if (0 == strcmp(str, "ansi"))
+		out = output_format::ansi;
+	else if (0 == strcmp(str, "compact"))
+		out = output_format::compact;
+	else if (0 == strcmp(str, "bin"))
+		out = output_format::bin;
+	else if (0 == strcmp(str, "ndjson"))
+		out = output_format::ndjson;
+	else
+		return false;
+	return true;
+}
+
+// "K/N", for the K'th of N shards
+[[nodiscard]] static auto parse_shard(char const *str, unsigned& shard, unsigned& num_shards) noexcept -> bool
+{
+	auto const slash = strchr(str, '/');
+	if (slash == nullptr)
+		return false;
+	std::string const k(str, slash);
+	return parse_unsigned(k.c_str(), shard) and parse_unsigned(slash + 1, num_shards) and
+	       shard >= 1 and shard <= num_shards and num_shards <= num_possible_rolls;
+}
+
+// Pull any options out of the command line, leaving the remaining
+// arguments in 'args'.  Returns false if an option was malformed.
+[[maybe_unused]] [[nodiscard]] static auto parse_options(int argn, char const * const *argv, run_options& opts, std::vector<char const *>& args) noexcept -> bool
+{
+	args.assign(argv, argv + 1);
+	for (int i = 1; i < argn; i++) {
+		auto const arg = argv[i];
+		if (0 == strcmp(arg, "--threads")) {
+			if (++i >= argn) {
+				[[unlikely]] fputs("Error: --threads requires a value\n", stderr);
+				return false;
+			}
+			if (not parse_unsigned(argv[i], opts.num_threads)) {
+				[[unlikely]] fprintf(stderr, "Error: Bad thread count: \"%s\"\n", argv[i]);
+				return false;
+			}
+			continue;
+		}
+		if (0 == strcmp(arg, "--format")) {
+			if (++i >= argn) {
+				[[unlikely]] fputs("Error: --format requires a value\n", stderr);
+				return false;
+			}
+			if (not parse_format(argv[i], opts.format)) {
+				[[unlikely]] fprintf(stderr, "Error: Unknown output format: \"%s\"\n", argv[i]);
+				return false;
+			}
+			continue;
+		}
+		if (0 == strcmp(arg, "--no-table")) {
+			opts.use_roll_table = false;
+			continue;
+		}
+		if (0 == strcmp(arg, "--db")) {
+			if (++i >= argn) {
+				[[unlikely]] fputs("Error: --db requires a value\n", stderr);
+				return false;
+			}
+			opts.db_path = argv[i];
+			continue;
+		}
+		if (0 == strcmp(arg, "--use-census")) {
+			if (++i >= argn) {
+				[[unlikely]] fputs("Error: --use-census requires a value\n", stderr);
+				return false;
+			}
+			opts.census_path = argv[i];
+			continue;
+		}
+		if (0 == strcmp(arg, "--shard")) {
+			if (++i >= argn) {
+				[[unlikely]] fputs("Error: --shard requires a value\n", stderr);
+				return false;
+			}
+			if (not parse_shard(argv[i], opts.shard, opts.num_shards)) {
+				[[unlikely]] fprintf(stderr, "Error: Bad shard (expected K/N, with 1 <= K <= N): \"%s\"\n", argv[i]);
+				return false;
+			}
+			continue;
+		}
+		if (0 == strcmp(arg, "--no-symmetry")) {
+			opts.use_symmetry = false;
+			continue;
+		}
+		if (0 == strcmp(arg, "--solutions")) {
+			if (++i >= argn) {
+				[[unlikely]] fputs("Error: --solutions requires a value\n", stderr);
+				return false;
+			}
+			if (not parse_unsigned(argv[i], opts.max_solutions)) {
+				[[unlikely]] fprintf(stderr, "Error: Bad solution count: \"%s\"\n", argv[i]);
+				return false;
+			}
+			continue;
+		}
+		if (0 == strcmp(arg, "--stats")) {
+			// There's nothing to measure if the answer just comes
+			// out of the roll table
+			opts.stats = true;
+			opts.use_roll_table = false;
+			continue;
+		}
+		if (0 == strcmp(arg, "--engine")) {
+			if (++i >= argn) {
+				[[unlikely]] fputs("Error: --engine requires a value\n", stderr);
+				return false;
+			}
+			if (not parse_engine(argv[i], opts.engine)) {
+				[[unlikely]] fprintf(stderr, "Error: Unknown engine: \"%s\"\n", argv[i]);
+				return false;
+			}
+			continue;
+		}
+		args.push_back(arg);
+	}
+	return true;
+}
+
+// Parse the seven positions of a board given on the command line
+[[maybe_unused]] [[nodiscard]] static auto parse_positions(char const * const *args, board_bitmask_t& blockers) noexcept -> bool
+{
+	blockers = 0;
+	bool parsed_ok = true;
+	for (unsigned i = 0; i < 7; i++) {
+		auto const arg = args[i];
+		auto const b = sbit(arg);
+		if (b == 0) {
+			[[unlikely]] parsed_ok = false;
+			fprintf(stderr, "Error: Bad board position: \"%s\"\n", arg);
+		}
+		if ((blockers & b) != 0) {
+			[[unlikely]] parsed_ok = false;
+			fprintf(stderr, "Error: Board position listed multiple times: \"%s\"\n", arg);
+		}
+		blockers |= b;
+	}
+	return parsed_ok;
+}
+
+// The library only promises to solve boards with exactly seven blockers
+[[nodiscard]] static auto library_board_is_valid(board_bitmask_t blockers) noexcept -> bool
+{
+	return (blockers & ~all_squares) == 0 and std::popcount(blockers) == 7;
+}
+
+} // anonymous namespace
+
+// The library interface, for gsqsolve.h
+auto gsqsolve::solve_many(std::span<board_bitmask_t const> boards, std::span<solution> solutions) noexcept -> void
+{
+	assert(boards.size() == solutions.size());
+
+	// The boards that need searching get collected up and handed to
+	// solve_boards() a chunk at a time, so that the SIMD engine can work
+	// on them together.  That finds the same solutions as the loop nest.
+	constexpr std::size_t chunk_size = 256;
+	std::array<board_bitmask_t, chunk_size> to_search;
+	std::array<std::optional<placement_indices_t>, chunk_size> found;
+	std::array<std::size_t, chunk_size> searched_board;
+	std::size_t num_to_search = 0;
+	auto const search = [&] {
+		solve_boards(std::span(to_search.data(), num_to_search), std::span(found.data(), num_to_search),
+			     solver_engine::simd, nullptr);
+		for (std::size_t j = 0; j < num_to_search; j++) {
+			if (found[j]) {
+				auto& s = solutions[searched_board[j]];
+				s.solved = true;
+				s.placements = *found[j];
+			}
+		}
+		num_to_search = 0;
+	};
+
+	for (std::size_t i = 0; i < boards.size(); i++) {
+		auto& s = solutions[i];
+		s.solved = false;
+		s.placements.fill(no_solution_index);
+		if (not library_board_is_valid(boards[i]))
+			[[unlikely]] continue;
+		board b(boards[i]);
+		if (solve_from_roll_table(boards[i], b)) {
+			s.solved = true;
+			s.placements = b.placement_indices();
+			continue;
+		}
+		to_search[num_to_search] = boards[i];
+		searched_board[num_to_search] = i;
+		if (++num_to_search == chunk_size)
+			search();
+	}
+	if (num_to_search > 0)
+		search();
+}
+
+auto gsqsolve::count_solutions(board_bitmask_t blockers) noexcept -> unsigned
+{
+	if (not library_board_is_valid(blockers))
+		[[unlikely]] return 0;
+#ifdef GSQSOLVE_ROLL_TABLE
+	if (blockers_are_valid_roll(blockers))
+		return roll_table[roll_index_of(blockers)].num_solutions;
+#endif
+	board b(blockers, solver_engine::narrowing);
+	return b.count_solutions();
+}
+
+auto gsqsolve::is_valid_roll(board_bitmask_t blockers) noexcept -> bool
+{
+	return library_board_is_valid(blockers) and blockers_are_valid_roll(blockers);
+}
+
+auto gsqsolve::placed_piece_name(unsigned position) noexcept -> char const *
+{
+	assert(position < placed_pieces.size());
+	return piece_names[static_cast<unsigned>(placed_pieces[position])];
+}
+
+auto gsqsolve::placement_squares(unsigned position, std::uint8_t index) noexcept -> board_bitmask_t
+{
+	assert(position < placed_pieces.size());
+	auto const placements = placements_of_piece[static_cast<unsigned>(placed_pieces[position])];
+	assert(index < placements.size());
+	return placements[index];
+}
+
+// The C interface, for gsqsolve-c.h
+extern "C" auto gsq_solve(std::uint64_t blockers, std::uint8_t out_placements[8]) -> int
+{
+	gsqsolve::solution s;
+	gsqsolve::solve_many(std::span(&blockers, 1), std::span(&s, 1));
+	memcpy(out_placements, s.placements.data(), s.placements.size());
+	return s.solved ? 1 : 0;
+}
+
+extern "C" auto gsq_count(std::uint64_t blockers) -> unsigned
+{
+	return gsqsolve::count_solutions(blockers);
+}
+
+extern "C" auto gsq_solve_many(std::uint64_t const *boards, std::size_t num_boards, std::uint8_t *out_placements) -> std::size_t
+{
+	// Go a chunk at a time, so the solutions can be kept on the stack.
+	// The chunks are as big as the ones solve_many() hands to the SIMD
+	// engine, since that's slower with fewer boards at a time.
+	std::array<gsqsolve::solution, 256> chunk;
+	std::size_t num_solved = 0;
+	for (std::size_t first = 0; first < num_boards; first += chunk.size()) {
+		auto const n = std::min(chunk.size(), num_boards - first);
+		gsqsolve::solve_many(std::span(&boards[first], n), std::span(chunk.data(), n));
+		for (std::size_t i = 0; i < n; i++) {
+			memcpy(&out_placements[(first + i) * gsqsolve::num_placed_pieces], chunk[i].placements.data(), gsqsolve::num_placed_pieces);
+			num_solved += chunk[i].solved ? 1 : 0;
+		}
+	}
+	return num_solved;
+}
+
+// gsqsolve-bench.cpp includes this file to get at the solver, and
+// supplies its own main(), and the libraries are built without one.  The
+// functions that only this main() calls are marked [[maybe_unused]] so
+// that those builds don't warn about them.
+#ifndef GSQSOLVE_NO_MAIN
+auto main(int argn, char const * const *argv) noexcept -> int
+{
+	run_options opts;
+	std::vector<char const *> args;
+	if (not parse_options(argn, argv, opts, args)) {
+		[[unlikely]] usage(stderr);
+		return EX_USAGE;
+	}
+	argn = static_cast<int>(args.size());
+	argv = args.data();
+
+	roll_database db;
+	if (opts.db_path != nullptr) {
+		if (not db.open(opts.db_path))
+			[[unlikely]] return EX_NOINPUT;
+		opts.db = &db;
+	}
+
+	shared_search_stats stats;
+	auto const stats_ptr = opts.stats ? &stats : nullptr;
+	auto const print_stats = [&] {
+		if (opts.stats)
+			print_search_stats(stats.total());
+	};
+
+	if (opts.num_shards != 1 and not (argn == 2 and (0 == strcmp(argv[1], "--verify-all") or
+							 0 == strcmp(argv[1], "--solution-counts")))) {
+		[[unlikely]] fputs("Error: --shard only works with --verify-all and --solution-counts\n", stderr);
+		return EX_USAGE;
+	}
+	// Printing several solutions always goes through the loop nest's
+	// generator, which can't use any of these
+	if (opts.max_solutions != 1 and (opts.engine != solver_engine::loop_nest or opts.stats or opts.db_path != nullptr)) {
+		[[unlikely]] fputs("Error: --solutions can't be used with --engine, --stats or --db\n", stderr);
+		return EX_USAGE;
+	}
+
+	if (argn == 2) {
+		auto const arg = argv[1];
+		if (0 == strcmp(arg, "--help")) {
+			usage(stdout);
+			return EX_OK;
+		}
+		if (0 == strcmp(arg, "--verify-all")) {
+			auto const ok = verify_all_possible_rolls(opts, stats_ptr);
+			print_stats();
+			return ok ? EX_OK : 1;
+		}
+		if (0 == strcmp(arg, "--batch"))
+			return solve_batch(opts);
+		if (0 == strcmp(arg, "--emit-roll-table")) {
+			emit_roll_table(opts);
+			return EX_OK;
+		}
+		if (0 == strcmp(arg, "--solution-counts")) {
+			count_solutions_of_every_board_position(opts, stats_ptr);
+			print_stats();
+			return EX_OK;
+		}
+	}
+	if (argn >= 2 and argn <= 3 and 0 == strcmp(argv[1], "--tiling-counts")) {
+		if (argn == 3 and 0 != strcmp(argv[2], "all")) {
+			[[unlikely]] usage(stderr);
+			return EX_USAGE;
+		}
+		count_solutions_by_tiling(opts, argn == 3);
+		return EX_OK;
+	}
+	if (argn >= 2 and argn <= 3 and 0 == strcmp(argv[1], "--random")) {
+		std::srand(static_cast<unsigned>(std::time(nullptr)));
+
+		auto const count = (argn == 2) ? 1u : static_cast<unsigned>(atoi(argv[2]));
+		if (count == 0) {
+			[[unlikely]] usage(stderr);
+			return EX_USAGE;
+		}
+		// The boards get rendered into one buffer, which is only
+		// written out when it fills up
+		std::array<char, 64 * 1024> out;
+		std::size_t out_size = 0;
+		auto const write_out = [&out, &out_size] {
+			auto const ok = fwrite(out.data(), 1, out_size, stdout) == out_size;
+			out_size = 0;
+			return ok;
+		};
+		bool written = true;
+		for (unsigned i = 0; i < count; i++) {
+			board b(random_blockers(), opts.engine);
+			if (not search_maybe_with_stats(stats_ptr, [&b](auto& s) { return b.solve(s); })) {
+				[[unlikely]] fputs("Error: No solution!\n", stderr);	// should be impossible!
+				return EX_SOFTWARE;
+			}
+			// Leave room for the blank line between boards too
+			if (out.size() - out_size < max_rendered_board_size + 1) {
+				written = write_out();
+				if (not written)
+					[[unlikely]] break;
+			}
+			if (i > 0 and opts.format == output_format::ansi)
+				out[out_size++] = '\n';
+			out_size += b.render(std::span(out).subspan(out_size), opts.format);
+		}
+		if (not written or not write_out() or fflush(stdout) != 0) {
+			[[unlikely]] fprintf(stderr, "Error: Couldn't write output: %s\n", strerror(errno));
+			return EX_IOERR;
+		}
+		print_stats();
+		return EX_OK;
+	}
+	if (argn >= 3 and 0 == strcmp(argv[1], "--merge"))
+		return merge_shards(std::span(&argv[2], static_cast<std::size_t>(argn - 2)));
+	if (argn == 3 and 0 == strcmp(argv[1], "--census"))
+		return write_census(opts, argv[2]);
+	if (argn == 3 and 0 == strcmp(argv[1], "--build-db"))
+		return write_roll_db(opts, argv[2]);
+	if (argn == 3 and 0 == strcmp(argv[1], "--serve")) {
+		solve_server server(opts);
+		return server.run(argv[2]);
+	}
+	board_bitmask_t blockers = 0;
+	if (argn == 3 and 0 == strcmp(argv[1], "--roll-index")) {
+		// Solve the roll that comes at this position in the order
+		// "--solution-counts" goes through them
+		unsigned idx;
+		if (not parse_unsigned(argv[2], idx) or idx >= num_possible_rolls) {
+			[[unlikely]] fprintf(stderr, "Error: Roll index must be less than %u: \"%s\"\n", num_possible_rolls, argv[2]);
+			return EX_USAGE;
+		}
+		blockers = roll_from_index(idx);
+	} else if (argn == 9 and 0 == strcmp(argv[1], "--roll-index")) {
+		// ...or go the other way, and print where a roll comes
+		if (not parse_positions(&argv[2], blockers)) {
+			[[unlikely]] usage(stderr);
+			return EX_USAGE;
+		}
+		if (not blockers_are_valid_roll(blockers)) {
+			[[unlikely]] fputs("Error: given board is not a valid dice roll\n", stderr);
+			return EX_DATAERR;
+		}
+		printf("%u\n", roll_index_of(blockers));
+		return EX_OK;
+	} else if (argn != 8 or not parse_positions(&argv[1], blockers)) {
+		[[unlikely]] usage(stderr);
+		return EX_USAGE;
+	}
+	// We can try to solve any board with 7 blockers, but at least
+	// print a warning if this isn't one that is reachable using the
+	// game's standard dice, since then we may not have a solution:
+	auto const valid_roll = blockers_are_valid_roll(blockers);
+	std::optional<unsigned> census_count;
+	if (not valid_roll) {
+		[[unlikely]] fputs("Warning: given board is not a valid dice roll\n", stderr);
+		// ...but the census can tell us for sure, without searching
+		if (opts.census_path != nullptr) {
+			census_file census;
+			if (not census.open(opts.census_path))
+				[[unlikely]] return EX_NOINPUT;
+			if (not census.is_solvable(blockers)) {
+				print_no_solution(blockers, opts.format);
+				return 1;
+			}
+			census_count = census.solution_count(blockers);
+		}
+	}
+	if (opts.max_solutions != 1) {
+		// Print each solution as soon as the loop nest finds it.  If the
+		// census says how many there are, stop at the last one instead
+		// of searching the rest of the board for more that aren't there.
+		auto max_solutions = opts.max_solutions;
+		if (census_count and (max_solutions == 0 or *census_count < max_solutions))
+			max_solutions = *census_count;
+		board b(blockers);
+		unsigned num_printed = 0;
+		for ([[maybe_unused]] auto const& placements : b.solutions()) {
+			if (num_printed > 0 and opts.format == output_format::ansi)
+				putchar('\n');
+			b.print(opts.format);
+			if (++num_printed == max_solutions)
+				break;
+		}
+		if (num_printed == 0) {
+			[[unlikely]] print_no_solution(blockers, opts.format);
+			return 1;
+		}
+		return EX_OK;
+	}
+	board b(blockers, opts.engine);
+	if (solve_without_searching(blockers, b, opts)) {
+		b.print(opts.format);
+		return EX_OK;
+	}
+	auto const solved = search_maybe_with_stats(stats_ptr, [&b](auto& s) { return b.solve(s); });
+	print_stats();
+	if (not solved) {
+		[[unlikely]] print_no_solution(blockers, opts.format);
 		assert(not valid_roll);
 		return 1;
 	}
-	b.print();
+	b.print(opts.format);
 	return EX_OK;
 }
+#endif // GSQSOLVE_NO_MAIN
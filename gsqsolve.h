@@ -0,0 +1,58 @@
+// The gsqsolve solver as a library
+//
+// "make libgsqsolve.a" builds the solver from gsqsolve.cpp without its
+// main(), so that other programs can solve boards without running gsqsolve
+// itself.  Only what's declared here is visible from outside; the rest of
+// gsqsolve.cpp stays private to it.
+//
+// A board is described by its seven blockers, as a bitmask with bit
+// (row * 6 + column) set for each one.  Row 0 is "a" and column 0 is "1",
+// so "a1" is bit 0, "a2" is bit 1 and "f6" is bit 35.  A solution gives,
+// for each of the pieces in the order placed_piece_name() lists them, the
+// index of where it went in that piece's array of placements.  The single
+// square piece goes wherever is left over.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+namespace gsqsolve {
+
+using board_bitmask_t = std::uint64_t;
+
+inline constexpr unsigned num_placed_pieces = 8;
+using placement_indices_t = std::array<std::uint8_t, num_placed_pieces>;
+
+struct solution {
+	// False if the board can't be solved, in which case 'placements'
+	// is all 0xFF
+	bool solved;
+	placement_indices_t placements;
+};
+
+// Solve every one of 'boards', putting each one's solution in the same
+// position of 'solutions' (which must be the same size).  Dice rolls come
+// from the precomputed table and the rest get searched together, using
+// the CPU's AVX2 or AVX-512 instructions if it has them, always finding
+// the same solution that "gsqsolve" would print.  Each thread that calls
+// this allocates some scratch space for that the first time, and reuses it
+// after that.  It's safe to call from any number of threads at once.
+auto solve_many(std::span<board_bitmask_t const> boards, std::span<solution> solutions) noexcept -> void;
+
+// How many different solutions 'blockers' has
+[[nodiscard]] auto count_solutions(board_bitmask_t blockers) noexcept -> unsigned;
+
+// Whether 'blockers' is a possible roll of the seven dice
+[[nodiscard]] auto is_valid_roll(board_bitmask_t blockers) noexcept -> bool;
+
+// The name of the piece that comes at 'position' in a solution, such as
+// "line4"
+[[nodiscard]] auto placed_piece_name(unsigned position) noexcept -> char const *;
+
+// The squares that the piece at 'position' in a solution covers, given
+// its placement index, as a bitmask like the blockers
+[[nodiscard]] auto placement_squares(unsigned position, std::uint8_t index) noexcept -> board_bitmask_t;
+
+} // namespace gsqsolve